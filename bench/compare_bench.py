@@ -0,0 +1,55 @@
+"""
+Compare benchmark results of ngstents_bench.py with a baseline:
+
+    python3 compare_bench.py baseline.json bench.json [--tolerance 0.1]
+
+Lists the results which are slower than the baseline by more than the
+tolerance (relative) and returns with exit code 1 if there are any.
+Results below --min-time seconds are too noisy and are not flagged.
+"""
+import argparse
+import json
+import sys
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("baseline")
+    parser.add_argument("current")
+    parser.add_argument("--tolerance", type=float, default=0.1)
+    parser.add_argument("--min-time", type=float, default=1e-4)
+    parser.add_argument("--all", action="store_true", help="list all results")
+    args = parser.parse_args()
+
+    with open(args.baseline) as f:
+        baseline = json.load(f)
+    with open(args.current) as f:
+        current = json.load(f)
+    base, cur = baseline["results"], current["results"]
+    if baseline["info"].get("host") != current["info"].get("host"):
+        print("warning: results from different hosts ({}, {})".format(
+            baseline["info"].get("host"), current["info"].get("host")))
+
+    regressions = []
+    print("{:60s} {:>12s} {:>12s} {:>8s}".format("benchmark", "baseline", "current", "ratio"))
+    for name in sorted(set(base) & set(cur)):
+        ratio = cur[name] / base[name] if base[name] > 0 else 1.0
+        slower = ratio > 1 + args.tolerance and cur[name] >= args.min_time
+        if slower:
+            regressions.append(name)
+        if slower or args.all:
+            print("{:60s} {:12.4e} {:12.4e} {:8.3f}{}".format(
+                name, base[name], cur[name], ratio, "  <-- slower" if slower else ""))
+    for name in sorted(set(base) - set(cur)):
+        print("missing in {}: {}".format(args.current, name))
+    for name in sorted(set(cur) - set(base)):
+        print("new in {}: {}".format(args.current, name))
+
+    print("{} of {} results slower by more than {:.0%}".format(
+        len(regressions), len(set(base) & set(cur)), args.tolerance))
+    return 1 if regressions else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
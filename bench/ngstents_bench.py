@@ -0,0 +1,162 @@
+"""
+Benchmarks of tent pitching and of the tent kernels of the conservation
+laws, written as JSON (see compare_bench.py):
+
+    python3 ngstents_bench.py --output bench.json [--threads 1,4] [--orders 2,4]
+
+Each result is the best of --repeat runs, in seconds:
+  pitch/<method>/<dim>d             PitchTents
+  poleheight/<method>/<dim>d        pole heights of all vertices (GetPoleHeight)
+  kernel/<eqn>/<dim>d/p<order>/t<threads>/<kernel>
+                                    one sweep of the kernel over all tents,
+                                    summed over the threads (ConservationLaw.Timing)
+  propagate/<eqn>/<dim>d/p<order>/t<threads>
+                                    Propagate of one slab
+"""
+import argparse
+import json
+import platform
+import time
+from datetime import datetime, timezone
+
+from ngsolve import (Mesh, CoefficientFunction, L2, GridFunction, TaskManager,
+                     SetNumThreads, exp, x, y, z)
+from netgen.geom2d import unit_square
+from netgen.csg import unit_cube
+import ngsolve
+from ngstents import TentSlab
+from ngstents.utils import Make1DMesh
+from ngstents.conslaw import Burgers, Euler, Wave, Advection, Maxwell
+
+
+def make_mesh(dim, quick):
+    if dim == 1:
+        return Mesh(Make1DMesh([[0, 1]], [100 if quick else 1000],
+                               bcname=["left", "right"]))
+    if dim == 2:
+        return Mesh(unit_square.GenerateMesh(maxh=0.1 if quick else 0.03))
+    return Mesh(unit_cube.GenerateMesh(maxh=0.3 if quick else 0.12))
+
+
+def gauss(dim):
+    r2 = (x-0.5)*(x-0.5)
+    if dim > 1:
+        r2 = r2 + (y-0.5)*(y-0.5)
+    if dim > 2:
+        r2 = r2 + (z-0.5)*(z-0.5)
+    return exp(-50*r2)
+
+
+def initial(eqn, dim):
+    g = gauss(dim)
+    if eqn == "burgers" or eqn == "advection":
+        return g
+    if eqn == "wave":
+        return CoefficientFunction(tuple([0]*dim) + (g,))
+    if eqn == "euler":
+        # density, momentum and energy with p = rho (see demo/euler/euler2d.py)
+        rho = 0.1 + g
+        return CoefficientFunction((rho,) + tuple([0]*dim) + (2.5*rho,))
+    if eqn == "maxwell":
+        return CoefficientFunction((0, 0, g, 0, 0, 0))
+
+
+# equation: (class, spatial dimensions, number of components)
+equations = {
+    "burgers": (Burgers, [1, 2], lambda dim: 1),
+    "advection": (Advection, [2], lambda dim: 1),
+    "wave": (Wave, [2, 3], lambda dim: dim+1),
+    "euler": (Euler, [2, 3], lambda dim: dim+2),
+    "maxwell": (Maxwell, [3], lambda dim: 2*dim),
+}
+
+
+def best(func, repeat):
+    times = []
+    for _ in range(repeat):
+        t = time.perf_counter()
+        func()
+        times.append(time.perf_counter() - t)
+    return min(times)
+
+
+def pitching(results, meshes, args):
+    for dim, mesh in meshes.items():
+        for method in ["edge", "vol"]:
+            ts = TentSlab(mesh, method=method)
+            ts.SetMaxWavespeed(1)
+            results["pitch/{}/{}d".format(method, dim)] = \
+                best(lambda: ts.PitchTents(dt=0.1, local_ct=True, global_ct=0.5),
+                     args.repeat)
+            results["poleheight/{}/{}d".format(method, dim)] = \
+                min(ts.TimePoleHeight(local_ct=True, global_ct=0.5, reps=5)
+                    for _ in range(args.repeat))
+
+
+def kernels(results, meshes, args):
+    for eqn, (ConsLaw, dims, ncomp) in equations.items():
+        for dim in dims:
+            mesh = meshes[dim]
+            ts = TentSlab(mesh, method="edge")
+            ts.SetMaxWavespeed(2)
+            ts.PitchTents(dt=0.05, local_ct=True, global_ct=0.5)
+            for order in args.orders:
+                V = L2(mesh, order=order, dim=ncomp(dim))
+                gfu = GridFunction(V)
+                bnd = mesh.Boundaries(".*")
+                if eqn == "advection":
+                    cl = ConsLaw(gfu, ts, inflow=bnd)
+                    cl.SetVectorField(CoefficientFunction((y-0.5, 0.5-x)))
+                elif eqn == "burgers":
+                    cl = ConsLaw(gfu, ts, outflow=bnd)
+                else:
+                    cl = ConsLaw(gfu, ts, reflect=bnd)
+                cl.SetTentSolver("SARK", stages=3, substeps=order)
+                for nthreads in args.threads:
+                    SetNumThreads(nthreads)
+                    with TaskManager():
+                        cl.SetInitial(initial(eqn, dim))
+                        key = "{}/{}d/p{}/t{}".format(eqn, dim, order, nthreads)
+                        timing = {}
+                        for _ in range(args.repeat):
+                            for name, t in cl.Timing(reps=3).items():
+                                timing[name] = min(t, timing.get(name, t))
+                        for name, t in timing.items():
+                            results["kernel/{}/{}".format(key, name)] = t
+                        results["propagate/" + key] = best(cl.Propagate, args.repeat)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--output", default="bench.json")
+    parser.add_argument("--threads", default="1",
+                        help="comma separated numbers of threads")
+    parser.add_argument("--orders", default="2,4",
+                        help="comma separated polynomial orders")
+    parser.add_argument("--repeat", type=int, default=3)
+    parser.add_argument("--quick", action="store_true",
+                        help="small meshes, for testing the benchmark")
+    args = parser.parse_args()
+    args.threads = [int(n) for n in args.threads.split(",")]
+    args.orders = [int(p) for p in args.orders.split(",")]
+
+    meshes = {dim: make_mesh(dim, args.quick) for dim in [1, 2, 3]}
+    results = {}
+    pitching(results, meshes, args)
+    kernels(results, meshes, args)
+
+    info = {
+        "date": datetime.now(timezone.utc).isoformat(),
+        "host": platform.node(),
+        "machine": platform.machine(),
+        "ngsolve": ngsolve.__version__,
+        "quick": args.quick,
+    }
+    with open(args.output, "w") as f:
+        json.dump({"info": info, "results": results}, f, indent=1, sort_keys=True)
+    print("wrote {} results to {}".format(len(results), args.output))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,49 @@
+from netgen.geom2d import SplineGeometry
+from ngsolve import Mesh, CoefficientFunction, exp, x, y
+from ngsolve import L2, GridFunction, TaskManager
+from ngstents import TentSlab
+from ngstents.conslaw import Advection
+from math import pi
+import numpy as np
+import time
+
+geom = SplineGeometry()
+geom.AddCircle(c=(0,0),r=1,bc="circle")
+mesh = Mesh(geom.GenerateMesh(maxh=0.2))
+
+# rotate an ensemble of pulses by a quarter turn
+tend = pi/2
+dt = tend/4
+wavespeed = 2
+
+ts = TentSlab(mesh, method="edge")
+ts.SetMaxWavespeed(wavespeed)
+ts.PitchTents(dt=dt, local_ct=True, global_ct=1)
+
+order = 3
+V = L2(mesh, order=order)
+gfu = GridFunction(V,"u")
+cl = Advection(gfu, ts, inflow=mesh.Boundaries("circle"))
+cl.SetVectorField( CoefficientFunction((y,-x)) )
+cl.SetTentSolver("SAT",stages=order+1, substeps=2*order)
+
+def Pulse(x0, y0):
+    return exp(-100*((x-x0)**2+(y-y0)**2))
+
+# the first member uses the same initial data as gfu
+centers = [(0.5, 0), (0, 0.5), (-0.3, 0.2), (0.1, -0.4)]
+cl.SetInitial(Pulse(*centers[0]))
+cl.SetEnsemble([Pulse(*c) for c in centers])
+
+t = 0
+t1 = time.time()
+with TaskManager():
+    while t < tend-dt/2:
+        cl.Propagate()
+        t += dt
+print("ensemble of {} members: total time = {}".format(
+    len(centers), time.time()-t1))
+
+U = cl.ensemble   # N x ndof view, no copy
+maxdiff = np.max(np.abs(U[0] - gfu.vec.FV().NumPy()))
+print("max difference member 0 and gfu = ", maxdiff)
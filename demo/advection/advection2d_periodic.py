@@ -41,7 +41,8 @@ V = L2(mesh, order=order)
 u = GridFunction(V)
 cl = Advection(u, ts)
 flux = (1,0.1)
-cl.SetVectorField( CoefficientFunction(flux) )
+# the vector field is time-independent: evaluate it once per mesh
+cl.SetVectorField( CoefficientFunction(flux), cache=True )
 cl.SetTentSolver("SAT",stages=order+1, substeps=2*order)
 
 pos = (0.5,0.5)
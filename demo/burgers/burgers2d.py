@@ -37,25 +37,25 @@ burg.SetInitial(cf)
 Draw(u)
 
 tend = 10*dt
-t = 0
-cnt = 0
 if ngs_gui:
     Draw(burg)
 
 if vtk_tents:
-    burg.VTKTents('temp')
+    ts.DrawPitchedTentsVTU('tents')
+
+
+def output(cnt, t):
+    print("{:.3f}".format(t))
+    Redraw(True)
+    if vtk_tents:
+        burg.WriteVTU('solution_{}'.format(cnt))
+    if step_sol:
+        input('step')
+
 
 input('start')
 with TaskManager():
-    while t < tend - dt/2:
-        burg.Propagate()
-        t += dt
-        cnt += 1
-        if cnt % 1 == 0:
-            print("{:.3f}".format(t))
-            Redraw(True)
-            if step_sol:
-                input('step')
+    burg.PropagateUntil(tend, output, every=1)
 
 if sol_vec:
     print(sol.vec)
@@ -27,6 +27,11 @@ u = GridFunction(V,"u")
 cl = Euler(u, ts, reflect=mesh.Boundaries("left|bottom|right|top"))
 cl.SetTentSolver("SARK",substeps=2*order)
 
+# positivity limiter as cheaper alternative to the entropy viscosity
+limiter = True
+if limiter:
+    cl.SetLimiter(positivity=True, viscosity=False)
+
 d = 5
 rho = CoefficientFunction(0.1+exp(-200*((x-0.5)*(x-0.5)+(y-0.5)*(y-0.5))))
 m = CoefficientFunction((0,0))
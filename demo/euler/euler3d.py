@@ -0,0 +1,180 @@
+from netgen.csg import CSGeometry, OrthoBrick, Pnt
+from ngsolve import (Mesh, Draw, Redraw, CoefficientFunction, IfPos, sqrt,
+                     exp, log, x, y, z, InnerProduct, OuterProduct, Id,
+                     L2, GridFunction, TaskManager)
+from ngsolve import specialcf as scf
+from ngsolve.internal import visoptions, viewoptions
+from ngstents import TentSlab
+from ngstents.conslaw import Euler, ConservationLaw
+from math import pi
+import time
+
+# compare the native 3D Euler equations with the equivalent
+# SymbolicConsLaw by setting symbolic = True
+symbolic = False
+# translate flux, numflux and inverse map of the symbolic version into
+# native kernels (compiled once, then reused from the on-disk cache)
+native = False
+
+geom = CSGeometry()
+brick = OrthoBrick(Pnt(0, 0, 0), Pnt(1, 1, 1)).bc("reflect")
+geom.Add(brick)
+mesh = Mesh(geom.GenerateMesh(maxh=0.15))
+
+dt = 0.02
+tend = 0.1
+
+# using causality constant
+local_ctau = True
+global_ctau = 1/2
+wavespeed = 6
+ts = TentSlab(mesh, method="edge", heapsize=10*1000*1000)
+ts.SetMaxWavespeed(wavespeed)
+ts.PitchTents(dt=dt, local_ct=local_ctau, global_ct=global_ctau)
+print("max slope", ts.MaxSlope())
+print("n tents", ts.GetNTents())
+
+order = 2
+V = L2(mesh, order=order, dim=mesh.dim+2)
+u = GridFunction(V, "u")
+
+d = 5
+n = scf.normal(mesh.dim)
+h = scf.mesh_size
+
+
+def Flux(u):
+    m = u[1:mesh.dim+1]
+    p = 2/d * (u[mesh.dim+1] - 1/2 * InnerProduct(m, m)/u[0])
+    return CoefficientFunction((m,
+                                Id(mesh.dim)*p + OuterProduct(m, m)/u[0],
+                                (u[mesh.dim+1] + p)/u[0] * m),
+                               dims=(V.dim, mesh.dim))
+
+
+def Erf(x):
+    # Abramowitz/Stegun approximation, as erf in src/euler.cpp
+    ax = IfPos(x, x, -x)
+    t = 1/(1 + 0.3275911*ax)
+    res = 1 - (((((1.061405429*t - 1.453152027)*t + 1.421413741)*t
+                 - 0.284496736)*t + 0.254829592)*t) * exp(-ax*ax)
+    return IfPos(x, res, -res)
+
+
+def HalfFlux(u, nn):
+    # flux of the particles of the Maxwellian state u leaving through
+    # the unit normal nn
+    rho = u[0]
+    U = u[1:mesh.dim+1]/rho
+    un = InnerProduct(U, nn)
+    normu2 = InnerProduct(U, U)
+    T = 4/d * (u[mesh.dim+1]/rho - 1/2*normu2)
+    T = IfPos(T, T, 1e-10)
+    sqrtT = sqrt(T)
+    s = -un/sqrtT
+    i0 = sqrt(pi)/2 * (1-Erf(s))
+    i1 = 1/2 * exp(-s*s)
+    i2 = 1/2 * i0 + s*i1
+    i3 = i1 * (1+s*s)
+    fac = rho/sqrt(pi)
+    return fac * CoefficientFunction(
+        (un*i0 + sqrtT*i1,
+         U*un*i0 + sqrtT*(un*nn + U)*i1 + T*i2*nn,
+         1/2*(un*(normu2 + (d-1)/2*T)*i0
+              + (2*un*un + normu2 + (d-1)/2*T)*sqrtT*i1
+              + 3*un*T*i2 + T*sqrtT*i3)))
+
+
+def NumFlux(um, up):
+    # kinetic flux, as the native Euler equations
+    return HalfFlux(um, n) - HalfFlux(up, -n)
+
+
+def Reflect(u):
+    # state with the normal velocity reflected, as u_reflect of Euler
+    m = u[1:mesh.dim+1]
+    return CoefficientFunction((u[0], m - 2*InnerProduct(m, n)*n,
+                                u[mesh.dim+1]))
+
+
+def InverseMap(y):
+    y_rho = y[0]
+    y_m = y[1:mesh.dim+1]
+    y_E = y[mesh.dim+1]
+    a1 = d/2 * (y_rho - InnerProduct(y_m, ts.gradphi))
+    a2 = 2*y_E*y_rho - InnerProduct(y_m, y_m)
+    normgrad = InnerProduct(ts.gradphi, ts.gradphi)
+    p = a2 / (a1 + sqrt(a1**2 - (d+1)*normgrad*a2))
+    rho = y_rho**2 / (y_rho - (InnerProduct(y_m, ts.gradphi) + p*normgrad))
+    m = rho/y_rho * (y_m + p*ts.gradphi)
+    E = 1/y_rho * (rho*y_E + p*InnerProduct(m, ts.gradphi))
+    return CoefficientFunction((rho, m, E))
+
+
+def Entropy(u):
+    rho = u[0]
+    m = u[1:mesh.dim+1]
+    T = 4/d * (u[mesh.dim+1]/rho - 1/2 * InnerProduct(m, m)/rho**2)
+    T = IfPos(-T, T, 1e-10)
+    return rho * (log(rho) - d/2 * log(T))
+
+
+def EntropyFlux(u):
+    return u[1:mesh.dim+1]/u[0] * Entropy(u)
+
+
+def NumEntropyFlux(um, up):
+    mn = InnerProduct(um[1:mesh.dim+1], n)
+    return IfPos(mn, mn/um[0] * Entropy(um),
+                 InnerProduct(up[1:mesh.dim+1], n)/up[0] * Entropy(up))
+
+
+def ViscosityCoefficient(u, res):
+    nu_entr = (h/order)**2 * IfPos(res, res, -res)
+    rho = u[0]
+    ip_m = InnerProduct(u[1:mesh.dim+1], u[1:mesh.dim+1])
+    T = 4/d * (u[mesh.dim+1]/rho - 1/2 * ip_m/rho**2)
+    nu_max = 1/20 * h/order * (sqrt(ip_m) + rho * sqrt((d+2)/d * T))
+    return IfPos(nu_max - nu_entr, nu_entr, nu_max)
+
+
+if symbolic:
+    cl = ConservationLaw(u, ts,
+                         flux=Flux, numflux=NumFlux, inversemap=InverseMap,
+                         entropy=Entropy, entropyflux=EntropyFlux,
+                         numentropyflux=NumEntropyFlux,
+                         visccoeff=ViscosityCoefficient,
+                         compile=True, native=native)
+    cl.SetBoundaryCF(mesh.BoundaryCF(
+        {"reflect": NumFlux(cl.u_minus, Reflect(cl.u_minus))}))
+else:
+    cl = Euler(u, ts, reflect=mesh.Boundaries("reflect"))
+cl.SetTentSolver("SARK", substeps=2*order)
+
+r2 = (x-0.5)**2 + (y-0.5)**2 + (z-0.5)**2
+rho = CoefficientFunction(0.1+exp(-100*r2))
+m = CoefficientFunction((0, 0, 0))
+p = CoefficientFunction(0.1+exp(-100*r2))
+T = 2*p/rho
+E = d/4*T*rho + 1/(2*rho)*m*m
+
+cl.SetInitial(CoefficientFunction((rho, m, E)))
+
+Draw(u)
+visoptions.scalfunction = "u:1"
+viewoptions.clipping.enable = 1
+visoptions.clipsolution = 'scal'
+
+t = 0
+cnt = 0
+t1 = time.time()
+with TaskManager():
+    while t < tend-dt/2:
+        cl.Propagate()
+        t += dt
+        cnt += 1
+        print("{:5f}".format(t))
+        Redraw(True)
+elapsed = time.time()-t1
+print("{} Euler: total time = {}, time per slab = {}".format(
+    "symbolic" if symbolic else "native", elapsed, elapsed/cnt))
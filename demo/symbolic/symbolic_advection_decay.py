@@ -0,0 +1,74 @@
+from ngsolve import Mesh, CoefficientFunction, IfPos, exp, x, y, InnerProduct
+from ngsolve import L2, GridFunction, TaskManager, Integrate, sqrt
+from ngsolve import specialcf as scf
+from netgen.geom2d import unit_square
+from ngstents import TentSlab
+from ngstents.conslaw import ConservationLaw
+import time
+
+# advection of a pulse with a linear decay, solved with the IMEX tent
+# solver:
+#   d_t u + div(b u) = -k u,   u(x,t) = exp(-k t) u0(x - b t)
+# the implicit source step acts on the mapped variable of the tents,
+# hence the decay rate does not depend on the slopes of the tents
+
+maxh = 0.08
+mesh = Mesh(unit_square.GenerateMesh(maxh=maxh))
+
+tend = 0.2
+dt = 0.05
+wavespeed = 1.5
+
+ts = TentSlab(mesh, method="edge")
+ts.SetMaxWavespeed(wavespeed)
+ts.PitchTents(dt=dt, local_ct=True, global_ct=1)
+
+order = 3
+V = L2(mesh, order=order)
+u = GridFunction(V)
+
+b = CoefficientFunction((1, 0.2))
+n = scf.normal(mesh.dim)
+k = 5
+
+
+def Flux(u):
+    return CoefficientFunction(b*u, dims=(V.dim, mesh.dim))
+
+
+def NumFlux(um, up):
+    bn = b*n
+    return IfPos(bn, bn*um, bn*up)
+
+
+def InverseMap(y):
+    return y/(1-InnerProduct(b, ts.gradphi))
+
+
+def Source(u):
+    return -k*u
+
+
+def Exact(t):
+    x0, y0 = 0.35 + b[0]*t, 0.4 + b[1]*t
+    return exp(-k*t) * exp(-100*((x-x0)*(x-x0)+(y-y0)*(y-y0)))
+
+
+cl = ConservationLaw(u, ts, flux=Flux, numflux=NumFlux, inversemap=InverseMap)
+cl.SetSource(Source)
+cl.SetBoundaryCF(NumFlux(cl.u_minus, 0))  # zero inflow
+cl.SetTentSolver("IMEX", stages=order+1, substeps=2*order)
+cl.SetInitial(Exact(0))
+
+t = 0
+t1 = time.time()
+with TaskManager():
+    while t < tend-dt/2:
+        cl.Propagate()
+        t += dt
+print("total time = ", time.time()-t1)
+
+exact = Exact(tend)
+l2error = sqrt(Integrate((u-exact)*(u-exact), mesh)) \
+    / sqrt(Integrate(exact*exact, mesh))
+print("relative L2 error = ", l2error)
@@ -0,0 +1,83 @@
+from ngsolve import Mesh, CoefficientFunction, IfPos, exp, x, y, InnerProduct
+from ngsolve import L2, GridFunction, TaskManager, Integrate, sqrt
+from ngsolve import specialcf as scf
+from ngstents import TentSlab
+from ngstents.conslaw import ConservationLaw
+import time
+
+
+def Make2DPeriodicMesh(xint, yint, maxh):
+    from netgen.geom2d import SplineGeometry
+    periodic = SplineGeometry()
+    pnts = [(xint[0], yint[0]), (xint[1], yint[0]),
+            (xint[1], yint[1]), (xint[0], yint[1])]
+    pnums = [periodic.AppendPoint(*p) for p in pnts]
+    lbot = periodic.Append(["line", pnums[0], pnums[1]], bc="bottom")
+    lright = periodic.Append(["line", pnums[1], pnums[2]], bc="right")
+    periodic.Append(["line", pnums[0], pnums[3]], leftdomain=0,
+                    rightdomain=1, bc="left", copy=lright)
+    periodic.Append(["line", pnums[3], pnums[2]], leftdomain=0,
+                    rightdomain=1, bc="top", copy=lbot)
+    return periodic.GenerateMesh(maxh=maxh)
+
+
+# advection with a stiff relaxation to the equilibrium ueq:
+#   d_t u + div(b u) = -k (u - ueq)
+# an explicit treatment of the source would need substeps ~ k
+
+maxh = 0.1
+mesh = Mesh(Make2DPeriodicMesh([0, 1], [0, 1], maxh))
+
+tend = 0.2
+dt = 0.1
+wavespeed = 2
+
+ts = TentSlab(mesh, method="edge")
+ts.SetMaxWavespeed(wavespeed)
+ts.PitchTents(dt=dt, local_ct=True, global_ct=1)
+
+order = 3
+V = L2(mesh, order=order)
+u = GridFunction(V)
+
+b = CoefficientFunction((1, 0.1))
+n = scf.normal(mesh.dim)
+k = 1e4
+ueq = 0.5
+
+
+def Flux(u):
+    return CoefficientFunction(b*u, dims=(V.dim, mesh.dim))
+
+
+def NumFlux(um, up):
+    bn = b*n
+    return IfPos(bn, bn*um, bn*up)
+
+
+def InverseMap(y):
+    return y/(1-InnerProduct(b, ts.gradphi))
+
+
+def Source(u):
+    return -k*(u-ueq)
+
+
+cl = ConservationLaw(u, ts, flux=Flux, numflux=NumFlux, inversemap=InverseMap)
+cl.SetSource(Source)
+cl.SetTentSolver("IMEX", stages=order+1, substeps=2*order)
+
+pos = (0.5, 0.5)
+cl.SetInitial(exp(-100 * ((x-pos[0])*(x-pos[0])+(y-pos[1])*(y-pos[1]))))
+
+t = 0
+t1 = time.time()
+with TaskManager():
+    while t < tend-dt/2:
+        cl.Propagate()
+        t += dt
+print("total time = ", time.time()-t1)
+
+# the solution has relaxed to the equilibrium
+l2dev = sqrt(Integrate((u-ueq)*(u-ueq), mesh))
+print("L2 deviation from equilibrium = ", l2dev)
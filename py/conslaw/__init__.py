@@ -1,4 +1,4 @@
-from ._pyconslaw import ConservationLaw
+from ._pyconslaw import ConservationLaw, SnapshotTimes, ReadSnapshot
 
 
 class Burgers(ConservationLaw):
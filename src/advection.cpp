@@ -2,11 +2,13 @@
 using namespace ngsolve;
 
 #include "tconservationlaw_tp_impl.hpp"
+#include "cfcache.hpp"
 
 template <int D>
 class Advection : public T_ConservationLaw<Advection<D>, D, 1, 0>
 {
   shared_ptr<CoefficientFunction> bfield = nullptr;
+  shared_ptr<CoefficientCache> bfield_cache = nullptr;
 
   typedef T_ConservationLaw<Advection<D>, D, 1, 0> BASE;
   
@@ -20,7 +22,26 @@ public:
   using BASE::NumFlux;
   using BASE::InverseMap;
 
-  void SetVectorField(shared_ptr<CoefficientFunction> cf) { bfield = cf; }
+  void SetVectorField(shared_ptr<CoefficientFunction> cf, bool cache)
+  {
+    bfield = cf;
+    bfield_cache = nullptr;
+    if (cache)
+      {
+        HeapReset hr(*this->pylh);
+        bfield_cache = make_shared<CoefficientCache>(bfield, this->ma, this->order,
+                                                     *this->pylh);
+      }
+  }
+
+  void EvaluateBField (const SIMD_BaseMappedIntegrationRule & mir,
+                       FlatMatrix<SIMD<double>> bmat) const
+  {
+    if (bfield_cache)
+      bfield_cache->Evaluate(mir, bmat);
+    else
+      bfield->Evaluate(mir, bmat);
+  }
   
   // solve for û: Û = ĝ(x̂, t̂, û) - ∇̂ φ(x̂, t̂) ⋅ f̂(x̂, t̂, û)
   // at all points in an integration rule
@@ -32,7 +53,7 @@ public:
     STACK_ARRAY(SIMD<double>, mem, D*mir.Size());
     FlatMatrix<SIMD<double>> bmat(D, mir.Size(), mem);
 
-    bfield->Evaluate (mir, bmat);
+    EvaluateBField (mir, bmat);
     for (size_t i : Range(mir))
       {
         SIMD<double> ip = 1.0;
@@ -46,7 +67,7 @@ public:
   void Flux (const SIMD_BaseMappedIntegrationRule & mir,
              FlatMatrix<SIMD<double>> u, FlatMatrix<SIMD<double>> flux) const
   {
-    bfield->Evaluate(mir, flux);
+    EvaluateBField(mir, flux);
     for (size_t i : Range(mir))
       flux.Col(i) *= u(0,i);
   }
@@ -58,7 +79,7 @@ public:
   {
     STACK_ARRAY(SIMD<double>, mem, D*mir.Size());
     FlatMatrix<SIMD<double>> bmat(D, mir.Size(), mem);
-    bfield->Evaluate(mir, bmat);
+    EvaluateBField(mir, bmat);
 
     for(size_t i : Range(mir))
       {
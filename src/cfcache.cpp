@@ -0,0 +1,103 @@
+#include "cfcache.hpp"
+
+CoefficientCache::CoefficientCache (shared_ptr<CoefficientFunction> acf,
+                                    shared_ptr<MeshAccess> ma, int order,
+                                    LocalHeap & lh)
+  : cf{acf}, dim{acf->Dimension()}
+{
+  size_t ne = ma->GetNE();
+  elfirst.SetSize(ne);
+  rulefirst.SetSize(ne+1);
+  nsimd_el.SetSize(ne);
+  nsimd_facet.SetSize(ne);
+
+  // sizes of the integration rules of TentDataFE
+  size_t total = 0;
+  rulefirst[0] = 0;
+  for (size_t i : Range(ne))
+    {
+      ELEMENT_TYPE et = ma->GetElType(ElementId(VOL,i));
+      auto & tr = TentRules::Get(et, order);
+      int nfacets = ElementTopology::GetNFacets(et);
+      elfirst[i] = total;
+      nsimd_el[i] = tr.Element().Size();
+      nsimd_facet[i] = tr.Facet().Size();
+      total += dim * (nsimd_el[i] + nfacets*nsimd_facet[i]);
+      rulefirst[i+1] = rulefirst[i] + 1 + nfacets;
+    }
+  values.SetSize(total);
+  rules.SetSize(rulefirst[ne]);
+#ifndef NDEBUG
+  // same layout as values, with the space dimension instead of dim
+  points.SetSize(ma->GetDimension() * total / dim);
+#endif
+
+  ParallelFor
+    (Range(ne), [&] (size_t i)
+     {
+       LocalHeap slh = lh.Split();
+       ElementId ei(VOL, i);
+       ElementTransformation & trafo = ma->GetTrafo (ei, slh);
+       ELEMENT_TYPE et = trafo.GetElementType();
+       auto & tr = TentRules::Get(et, order);
+       auto vnums = ma->GetElVertices (ei);
+       int nfacets = ElementTopology::GetNFacets(et);
+
+       size_t first = elfirst[i];
+       for (int k = -1; k < nfacets; k++)
+         {
+           HeapReset hr(slh);
+           auto & ir = (k < 0) ? tr.Element() : tr.FacetOnElement(k, vnums);
+           rules[rulefirst[i]+1+k] = &ir;
+           auto & mir = trafo(ir, slh);
+           FlatMatrix<SIMD<double>> vals(dim, ir.Size(), &values[first]);
+           cf->Evaluate(mir, vals);
+#ifndef NDEBUG
+           int sdim = ma->GetDimension();
+           size_t firstpt = sdim*first/dim;
+           for (size_t j : Range(ir))
+             for (int l : Range(sdim))
+               points[firstpt + j*sdim + l] = ir[j](l);
+#endif
+           first += dim*ir.Size();
+         }
+     });
+}
+
+void CoefficientCache::Evaluate (const SIMD_BaseMappedIntegrationRule & mir,
+                                 FlatMatrix<SIMD<double>> vals) const
+{
+  auto & trafo = mir.GetTransformation();
+  if (trafo.VB() == VOL && mir.Size())
+    {
+      size_t elnr = trafo.GetElementNr();
+      auto & ir = mir.IR();
+      size_t first = size_t(-1);
+      auto elrules = rules.Range(rulefirst[elnr], rulefirst[elnr+1]);
+      if (&ir == elrules[0])
+        first = elfirst[elnr];
+      else
+        {
+          int facetnr = ir[0].FacetNr();
+          if (facetnr >= 0 && facetnr+1 < int(elrules.Size())
+              && &ir == elrules[facetnr+1])
+            first = elfirst[elnr] + dim*(nsimd_el[elnr] + facetnr*nsimd_facet[elnr]);
+        }
+
+      if (first != size_t(-1))
+        {
+#ifndef NDEBUG
+          int sdim = mir.DimElement();
+          size_t firstpt = sdim*first/dim;
+          for (size_t j : Range(ir))
+            for (int k : Range(sdim))
+              if (HSum(abs(ir[j](k) - points[firstpt + j*sdim + k])) > 1e-12)
+                throw Exception("CoefficientCache: points of a cached rule changed");
+#endif
+          vals = FlatMatrix<SIMD<double>> (dim, mir.Size(),
+                                           const_cast<SIMD<double>*>(values.Data()+first));
+          return;
+        }
+    }
+  cf->Evaluate(mir, vals);
+}
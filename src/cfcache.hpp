@@ -0,0 +1,47 @@
+#ifndef CFCACHE_HPP
+#define CFCACHE_HPP
+
+#include "tents.hpp"
+
+
+////////////////////////////////////////////////////////////////////////////
+///
+/// Values of a time-independent coefficient function at all integration
+/// points used by the tent kernels, evaluated once per mesh.
+///
+/// For every element we store the values at the element rule of
+/// TentRules followed by the values at the facet rule mapped to each of
+/// its local facets.  All values are kept in one compact array.  The
+/// rules of TentRules are shared by all tents, so a lookup compares the
+/// address of the rule of mir with the rules of the element; other
+/// rules are evaluated by the coefficient function.
+///
+class CoefficientCache
+{
+  shared_ptr<CoefficientFunction> cf;
+  int dim;
+  Array<SIMD<double>> values;  ///< cached values of all elements
+  Array<size_t> elfirst;       ///< position of element values in values
+  Array<int> nsimd_el;         ///< # SIMD points of the element rule
+  Array<int> nsimd_facet;      ///< # SIMD points of a facet rule
+  /// rules of the cached values: element rule, then the facet rule on
+  /// each local facet, starting at rulefirst[elnr]
+  Array<const SIMD_IntegrationRule*> rules;
+  Array<size_t> rulefirst;
+#ifndef NDEBUG
+  /// reference coordinates of the cached points, to check the lookup
+  Array<SIMD<double>> points;
+#endif
+
+public:
+  CoefficientCache (shared_ptr<CoefficientFunction> acf,
+                    shared_ptr<MeshAccess> ma, int order, LocalHeap & lh);
+
+  /// Copy cached values for the points of mir into values. Falls back to
+  /// evaluating the coefficient function if mir does not use a rule of
+  /// TentRules.
+  void Evaluate (const SIMD_BaseMappedIntegrationRule & mir,
+                 FlatMatrix<SIMD<double>> values) const;
+};
+
+#endif // CFCACHE_HPP
@@ -0,0 +1,217 @@
+#include "checkpoint.hpp"
+#include "conservationlaw.hpp"
+#include <fstream>
+#include <filesystem>
+
+static const char checkpoint_magic[8] = { 'N','G','S','T','C','H','K','P' };
+static const uint64_t checkpoint_version = 1;
+static constexpr size_t checkpoint_namelen = 32;
+static constexpr size_t checkpoint_align = 64;
+
+struct CheckpointEntry
+{
+  char name[checkpoint_namelen];
+  uint64_t offset, bytes, elsize;
+};
+
+static size_t Align (size_t n)
+{
+  return (n + checkpoint_align-1) / checkpoint_align * checkpoint_align;
+}
+
+
+const CheckpointFile::Section & CheckpointFile :: Find (const string & name) const
+{
+  for (auto & s : sections)
+    if (s.name == name)
+      return s;
+  throw Exception("checkpoint: no section " + name);
+}
+
+bool CheckpointFile :: Has (const string & name) const
+{
+  for (auto & s : sections)
+    if (s.name == name)
+      return true;
+  return false;
+}
+
+void CheckpointFile :: Write (const string & filename) const
+{
+  Array<CheckpointEntry> toc(sections.Size());
+  size_t offset = Align(sizeof(checkpoint_magic) + 2*sizeof(uint64_t)
+                        + toc.Size()*sizeof(CheckpointEntry));
+  for (size_t i : Range(sections))
+    {
+      auto & s = sections[i];
+      if (s.name.size() >= checkpoint_namelen)
+        throw Exception("checkpoint: section name too long: " + s.name);
+      std::memset(toc[i].name, 0, checkpoint_namelen);
+      std::memcpy(toc[i].name, s.name.data(), s.name.size());
+      toc[i].offset = offset;
+      toc[i].bytes = s.data.Size();
+      toc[i].elsize = s.elsize;
+      offset = Align(offset + s.data.Size());
+    }
+
+  string tmpname = filename + ".tmp";
+  {
+    std::ofstream out(tmpname, std::ios::binary);
+    if (!out)
+      throw Exception("cannot open checkpoint file " + tmpname);
+    uint64_t nsections = sections.Size();
+    out.write(checkpoint_magic, sizeof(checkpoint_magic));
+    out.write(reinterpret_cast<const char*>(&checkpoint_version), sizeof(uint64_t));
+    out.write(reinterpret_cast<const char*>(&nsections), sizeof(uint64_t));
+    out.write(reinterpret_cast<const char*>(toc.Data()), toc.Size()*sizeof(CheckpointEntry));
+    for (size_t i : Range(sections))
+      {
+        // zero padding up to the aligned offset
+        static const char zeros[checkpoint_align] = { 0 };
+        out.write(zeros, toc[i].offset - size_t(out.tellp()));
+        out.write(sections[i].data.Data(), sections[i].data.Size());
+      }
+    if (!out)
+      throw Exception("writing checkpoint file " + tmpname + " failed");
+  }
+  std::filesystem::rename(tmpname, filename);
+}
+
+void CheckpointFile :: Read (const string & filename)
+{
+  std::ifstream in(filename, std::ios::binary);
+  if (!in)
+    throw Exception("cannot open checkpoint file " + filename);
+  char magic[sizeof(checkpoint_magic)];
+  uint64_t version, nsections;
+  in.read(magic, sizeof(magic));
+  in.read(reinterpret_cast<char*>(&version), sizeof(uint64_t));
+  in.read(reinterpret_cast<char*>(&nsections), sizeof(uint64_t));
+  if (!in || std::memcmp(magic, checkpoint_magic, sizeof(magic)) != 0
+      || version != checkpoint_version)
+    throw Exception(filename + " is not a checkpoint file");
+
+  Array<CheckpointEntry> toc(nsections);
+  in.read(reinterpret_cast<char*>(toc.Data()), toc.Size()*sizeof(CheckpointEntry));
+  sections.SetSize0();
+  for (auto & e : toc)
+    {
+      Array<char> data(e.bytes);
+      in.seekg(e.offset);
+      in.read(data.Data(), e.bytes);
+      sections.Append(Section{string(e.name), e.elsize, std::move(data)});
+    }
+  if (!in)
+    throw Exception("checkpoint file " + filename + " is truncated");
+}
+
+
+void ConservationLaw :: SaveCheckpoint (const string & filename, bool slab)
+{
+  // one checkpoint at a time, the data are copied before writing starts
+  WaitCheckpoint();
+  auto file = make_shared<CheckpointFile>();
+  file->Add("equation", FlatArray<char>(equation.size(), const_cast<char*>(equation.data())));
+  file->Add("u", u->FVDouble());
+  file->Add("uinit", uinit->FVDouble());
+  file->Add("tau", gftau->GetVector().FVDouble());
+  Array<double> time = { slab_time };
+  file->Add("time", FlatArray<double>(time));
+  if (gfnu)
+    file->Add("nu", gfnu->GetVector().FVDouble());
+  file->Add("bcnr", BCNumbers());
+  if (ensemble_u.Height())
+    {
+      file->Add("ensemble.u", FlatArray<double>(ensemble_u.AsVector().Size(),
+                                                ensemble_u.Data()));
+      file->Add("ensemble.uinit", FlatArray<double>(ensemble_uinit.AsVector().Size(),
+                                                    ensemble_uinit.Data()));
+    }
+  if (slab)
+    {
+      TentTables tt = tps->GetTentTables();
+      Array<double> dt = { tt.dt };
+      Array<int> nlayers = { tt.nlayers };
+      file->Add("slab.dt", FlatArray<double>(dt));
+      file->Add("slab.nlayers", FlatArray<int>(nlayers));
+      file->Add("slab.vmap", FlatArray<int>(tt.vmap));
+      file->Add("slab.vertex", FlatArray<int>(tt.vertex));
+      file->Add("slab.level", FlatArray<int>(tt.level));
+      file->Add("slab.tbot", FlatArray<double>(tt.tbot));
+      file->Add("slab.ttop", FlatArray<double>(tt.ttop));
+      file->Add("slab.maxslope", FlatArray<double>(tt.maxslope));
+      file->Add("slab.nbv", tt.nbv);
+      file->Add("slab.nbtime", tt.nbtime);
+      file->Add("slab.els", tt.els);
+      file->Add("slab.facets", tt.internal_facets);
+      file->Add("slab.dependent", tt.dependent_tents);
+    }
+  checkpoint_writing = std::async(std::launch::async,
+                                  [file, filename] () { file->Write(filename); }).share();
+}
+
+void ConservationLaw :: WaitCheckpoint ()
+{
+  if (checkpoint_writing.valid())
+    {
+      auto writing = checkpoint_writing;
+      checkpoint_writing = std::shared_future<void>();
+      writing.get();   // rethrows errors of the writer
+    }
+}
+
+void ConservationLaw :: LoadCheckpoint (const string & filename)
+{
+  WaitCheckpoint();
+  CheckpointFile file;
+  file.Read(filename);
+
+  auto eqn = file.Get<char>("equation");
+  if (string(eqn.Data(), eqn.Size()) != equation)
+    throw Exception("checkpoint of equation " + string(eqn.Data(), eqn.Size())
+                    + ", not " + equation);
+  auto set = [&] (const string & name, FlatVector<> v)
+    {
+      auto data = file.Get<double>(name);
+      if (data.Size() != v.Size())
+        throw Exception("checkpoint: size of " + name + " does not match the space");
+      v = FlatVector<>(data.Size(), data.Data());
+    };
+  set("u", u->FVDouble());
+  set("uinit", uinit->FVDouble());
+  set("tau", gftau->GetVector().FVDouble());
+  slab_time = file.Get<double>("time")[0];
+  if (gfnu && file.Has("nu"))
+    set("nu", gfnu->GetVector().FVDouble());
+  auto bcnr = file.Get<int>("bcnr");
+  if (bcnr.Size() != BCNumbers().Size())
+    throw Exception("checkpoint: boundary conditions of a different mesh");
+  SetBCNumbers(bcnr);
+  if (file.Has("ensemble.u"))
+    {
+      SetEnsembleSize(file.Get<double>("ensemble.u").Size() / u->FVDouble().Size());
+      set("ensemble.u", ensemble_u.AsVector());
+      set("ensemble.uinit", ensemble_uinit.AsVector());
+    }
+
+  if (file.Has("slab.vertex"))
+    {
+      TentTables tt;
+      tt.dt = file.Get<double>("slab.dt")[0];
+      tt.nlayers = file.Get<int>("slab.nlayers")[0];
+      tt.vmap = file.Get<int>("slab.vmap");
+      if (tt.vmap.Size() != ma->GetNV())
+        throw Exception("checkpoint: tents of a different mesh");
+      tt.vertex = file.Get<int>("slab.vertex");
+      tt.level = file.Get<int>("slab.level");
+      tt.tbot = file.Get<double>("slab.tbot");
+      tt.ttop = file.Get<double>("slab.ttop");
+      tt.maxslope = file.Get<double>("slab.maxslope");
+      tt.nbv = file.GetTable<int>("slab.nbv");
+      tt.nbtime = file.GetTable<double>("slab.nbtime");
+      tt.els = file.GetTable<int>("slab.els");
+      tt.internal_facets = file.GetTable<int>("slab.facets");
+      tt.dependent_tents = file.GetTable<int>("slab.dependent");
+      tps->SetTentTables(tt);
+    }
+}
@@ -0,0 +1,83 @@
+#ifndef CHECKPOINT_HPP
+#define CHECKPOINT_HPP
+
+#include <solve.hpp>
+#include <cstring>
+using namespace ngsolve;
+
+
+////////////////////////////////////////////////////////////////////////////
+///
+/// Named arrays stored in a binary file, used for checkpoints.
+///
+/// Layout: magic "NGSTCHKP", version and number of sections (uint64),
+/// a table of contents with name (32 chars), offset, size in bytes and
+/// element size (uint64) of each section, then the data of the sections,
+/// each starting at a multiple of 64 bytes, so that the file can be
+/// mapped into memory and the arrays used in place.  The arrays are
+/// copied when they are added, hence a file can be written in the
+/// background while the original data change.
+///
+class CheckpointFile
+{
+  struct Section
+  {
+    string name;
+    size_t elsize;
+    Array<char> data;
+  };
+  Array<Section> sections;
+
+  const Section & Find (const string & name) const;
+
+public:
+  template <typename T>
+  void Add (const string & name, FlatArray<T> a)
+  {
+    Array<char> data(a.Size()*sizeof(T));
+    std::memcpy(data.Data(), a.Data(), data.Size());
+    sections.Append(Section{name, sizeof(T), std::move(data)});
+  }
+
+  void Add (const string & name, FlatVector<> v)
+  { Add(name, FlatArray<double>(v.Size(), v.Data())); }
+
+  template <typename T>
+  void Add (const string & name, const Table<T> & tab)
+  {
+    Add(name+".index", tab.IndexArray());
+    Add(name, tab.AsArray());
+  }
+
+  bool Has (const string & name) const;
+
+  template <typename T>
+  FlatArray<T> Get (const string & name) const
+  {
+    const Section & s = Find(name);
+    if (s.elsize != sizeof(T))
+      throw Exception("checkpoint: unexpected type of " + name);
+    return FlatArray<T>(s.data.Size()/sizeof(T),
+                        reinterpret_cast<T*>(const_cast<char*>(s.data.Data())));
+  }
+
+  template <typename T>
+  Table<T> GetTable (const string & name) const
+  {
+    auto index = Get<size_t>(name+".index");
+    auto data = Get<T>(name);
+    Array<int> sizes(index.Size()-1);
+    for (size_t i : Range(sizes))
+      sizes[i] = index[i+1]-index[i];
+    Table<T> tab(sizes);
+    tab.AsArray() = data;
+    return tab;
+  }
+
+  /// writes filename.tmp first and renames it, so that an existing
+  /// checkpoint is replaced only by a complete one
+  void Write (const string & filename) const;
+  void Read (const string & filename);
+};
+
+#endif // CHECKPOINT_HPP
@@ -7,7 +7,9 @@
 #include "tents.hpp"
 #include "tentsolver.hpp"
 #include "vis3d.hpp"
+#include "snapshot.hpp"
 #include <atomic>
+#include <future>
 
 class ConservationLaw
 {
@@ -27,10 +29,32 @@ public:
   shared_ptr<BaseVector> u = nullptr;     // u(n)
   shared_ptr<BaseVector> uinit = nullptr; // initial data, also used for bc
 
+  // ensemble members propagated together with u, one row per member;
+  // the memory is shared with numpy views (see "ensemble" in python),
+  // which keep it alive when the ensemble is resized
+  shared_ptr<Array<double>> ensemble_mem;
+  FlatMatrix<> ensemble_u;
+  FlatMatrix<> ensemble_uinit;
+  // vectors on the rows of the matrices above
+  Array<shared_ptr<BaseVector>> ensemble_vecs;
+  Array<shared_ptr<BaseVector>> ensemble_vecs_init;
+
   shared_ptr<TentSolver> tentsolver;
+  Array<int> tent_substeps;  // substeps used in each tent of the last slab
+
+  // limiter applied after each substep of the tent solvers (see LimitTent)
+  bool limit_positivity = false;
+  bool limit_bounds = false;
+  bool entropy_viscosity = true;  // for ECOMP > 0
+
+  // source term s(u) on the right hand side, treated by the IMEX solver
+  bool has_source = false;
 
   shared_ptr<GridFunction> gftau = nullptr;  // advancing front (used for time-dependent bc)
   shared_ptr<CoefficientFunction> cftau = nullptr;  // CF representing gftau
+  // physical time of the flat front after the last slab; kept separately,
+  // since gftau is not updated at periodic servant vertices
+  double slab_time = 0.0;
 
   shared_ptr<ProxyFunction> proxy_u = nullptr;
   shared_ptr<ProxyFunction> proxy_uother = nullptr;
@@ -38,6 +62,25 @@ public:
   // instance for 3D visualization of tent slab solutions based on 2D meshes.
   shared_ptr<Visualization3D> vis3d = nullptr;
 
+  // time series output of u at the end of the slabs (see SnapshotWriter)
+  shared_ptr<SnapshotWriter> snapshots = nullptr;
+
+  // point probes (see AddProbe), recorded by the tent solvers at the
+  // end of each substep of the tents containing them (see RecordProbes)
+  Array<int> probe_el;                // element containing the probe
+  Array<IntegrationPoint> probe_ip;   // reference point in this element
+  Table<int> el_probes;               // probes in each element
+  Array<Array<double>> probe_times;   // physical times of the samples
+  Array<Array<double>> probe_values;  // u->EntrySize() values per sample
+
+  // output on flat time slices within the next slab (see SliceTent):
+  // slice_gfs[k] receives the solution at the physical time slice_times[k]
+  Array<double> slice_times;
+  Array<shared_ptr<GridFunction>> slice_gfs;
+
+  // checkpoint being written in the background (see SaveCheckpoint)
+  std::shared_future<void> checkpoint_writing;
+
   shared_ptr<ProxyFunction> proxy_graddelta = nullptr;
   shared_ptr<ProxyFunction> proxy_res = nullptr;
 public:
@@ -48,29 +91,140 @@ public:
       equation {eqn}, order{agfu->GetFESpace()->GetOrder()}
   { };
   
-  virtual ~ConservationLaw() { ; }
+  virtual ~ConservationLaw()
+  {
+    if (checkpoint_writing.valid())
+      checkpoint_writing.wait();
+  }
+
+  void SetEnsembleSize (size_t n)
+  {
+    size_t ndof = u->FVDouble().Size();
+    ensemble_mem = make_shared<Array<double>>(2*n*ndof);
+    ensemble_u.AssignMemory(n, ndof, ensemble_mem->Data());
+    ensemble_uinit.AssignMemory(n, ndof, ensemble_mem->Data()+n*ndof);
+    ensemble_vecs.SetSize(n);
+    ensemble_vecs_init.SetSize(n);
+    for (size_t k : Range(n))
+      {
+        ensemble_vecs[k] = make_shared<S_BaseVectorPtr<double>>
+          (u->Size(), u->EntrySize(), &ensemble_u(k,0));
+        ensemble_vecs_init[k] = make_shared<S_BaseVectorPtr<double>>
+          (u->Size(), u->EntrySize(), &ensemble_uinit(k,0));
+      }
+  }
   
+  // add a probe at a point of the mesh, returns its number
+  int AddProbe (FlatVector<> point)
+  {
+    IntegrationPoint ip;
+    int elnr = ma->FindElementOfPoint(point, ip, true);
+    if (elnr < 0)
+      throw Exception("probe point is not in the mesh");
+    // RecordProbes interpolates the fronts with barycentric coordinates
+    if (ElementTopology::GetNVertices(ma->GetElType(ElementId(VOL, elnr)))
+        != ma->GetDimension()+1)
+      throw Exception("probes are only supported on simplicial elements");
+    probe_el.Append(elnr);
+    probe_ip.Append(ip);
+    probe_times.Append(Array<double>());
+    probe_values.Append(Array<double>());
+
+    TableCreator<int> creator(ma->GetNE());
+    for ( ; !creator.Done(); creator++)
+      for (size_t i : Range(probe_el))
+        creator.Add(probe_el[i], i);
+    el_probes = creator.MoveTable();
+    return probe_el.Size()-1;
+  }
+
+  // forget the recorded samples, keep the probes
+  void ClearProbes ()
+  {
+    for (auto & times : probe_times)
+      times.SetSize0();
+    for (auto & values : probe_values)
+      values.SetSize0();
+  }
+
   virtual void SetBC(int bcnr, const BitArray & region) = 0;
 
   virtual void CheckBC() = 0;
 
+  // boundary condition numbers of the facets (for checkpoints)
+  virtual FlatArray<int> BCNumbers() = 0;
+  virtual void SetBCNumbers(FlatArray<int> abcnr) = 0;
+
   virtual void SetBoundaryCF(int bcnr, shared_ptr<CoefficientFunction> cf) = 0;
   
-  virtual void SetVectorField(shared_ptr<CoefficientFunction> cf) = 0;
+  // cache = true: the coefficients are time-independent and evaluated
+  // once at all integration points of the mesh (see CoefficientCache)
+  virtual void SetVectorField(shared_ptr<CoefficientFunction> cf, bool cache) = 0;
 
   virtual void SetMaterialParameters(shared_ptr<CoefficientFunction> cf_mu,
-                                     shared_ptr<CoefficientFunction> cf_eps) = 0;
+                                     shared_ptr<CoefficientFunction> cf_eps,
+                                     bool cache) = 0;
 
   virtual void SetViscosityCoefficient(shared_ptr<CoefficientFunction> cf_visc) = 0;
 
   virtual void SetNumEntropyFlux(shared_ptr<CoefficientFunction> cf_numentropyflux) = 0;
 
+  // translate (uncompiled) flux, numerical flux and inverse map into
+  // native kernels (see NativeKernel)
+  virtual void SetNativeKernels(shared_ptr<CoefficientFunction> cf_flux,
+                                shared_ptr<CoefficientFunction> cf_numflux,
+                                shared_ptr<CoefficientFunction> cf_invmap) = 0;
+
   virtual void SetTentSolver(string method, int stages, int substeps) = 0;
 
+  virtual void SetLimiter(bool positivity, bool bounds, bool viscosity) = 0;
+
+  // source s(u) and its derivative in direction proxy_uother
+  virtual void SetSource(shared_ptr<CoefficientFunction> cf_source,
+                         shared_ptr<CoefficientFunction> cf_dsource) = 0;
+
   // virtual void Propagate(LocalHeap & lh) = 0;
 
   virtual void Propagate(LocalHeap & lh, shared_ptr<GridFunction> hdgf) = 0;
 
+  // benchmark of the tent kernels: for each kernel the seconds of one
+  // sweep over all tents of the slab (average of reps calls per tent),
+  // summed over the threads
+  virtual Array<std::pair<string,double>> Timing(int reps, LocalHeap & lh) = 0;
+
+  // physical time of the (flat) front after the last slab
+  double GetTime() const { return slab_time; }
+
+  // propagate slab by slab until tend is reached (up to half a slab),
+  // callback(nslabs, time) is called after every "every" slabs and stops
+  // the loop if it returns false; returns the number of slabs
+  int PropagateUntil(double tend, const function<bool(int,double)> & callback,
+                     int every, LocalHeap & lh, shared_ptr<GridFunction> hdgf)
+  {
+    const double dt = tps->GetSlabHeight();
+    int nslabs = 0;
+    while (GetTime() < tend - dt/2)
+      {
+        Propagate(lh, hdgf);
+        nslabs++;
+        if (callback && every > 0 && nslabs % every == 0)
+          if (!callback(nslabs, GetTime()))
+            break;
+      }
+    return nslabs;
+  }
+
+  // save the state (solution, initial/boundary data, front, slab time,
+  // viscosity, bc numbers and optionally the tents of the slab) to a
+  // checkpoint file (see CheckpointFile), the file is written in a
+  // background thread.  Every call copies the whole state and writes a
+  // complete new file, there is no incremental update of a checkpoint.
+  void SaveCheckpoint(const string & filename, bool slab);
+  // restore a state saved by SaveCheckpoint into this conservation law,
+  // which has to be set up on the same mesh and space
+  void LoadCheckpoint(const string & filename);
+  // wait for a checkpoint being written, rethrows errors of the writer
+  void WaitCheckpoint();
 };
 
 
@@ -87,13 +241,14 @@ public:
 ///
 /// The equation is
 ///
-///      d_t u + div_x F(u) = 0,     on Omega, 
+///      d_t u + div_x F(u) = s(u),     on Omega, 
 ///
 /// where
 ///
 ///   -  Omega = An DIM-space dimensional domain,
 ///   -      u = Solution, an COMP x 1 vector function,
 ///   -      F = Flux, an COMP x DIM matrix function,
+///   -      s = Source (optional, zero unless has_source is set),
 ///   -    d_t = time derivative,
 ///   -   div_x = row-wise spatial divergence.
 ///
@@ -214,6 +369,14 @@ public:
         }
   }
 
+  FlatArray<int> BCNumbers() { return bcnr; }
+
+  void SetBCNumbers(FlatArray<int> abcnr)
+  {
+    def_bcnr = true;
+    bcnr = abcnr;
+  }
+
   void SetBoundaryCF(int bcnr, shared_ptr<CoefficientFunction> cf)
   {
     if(cf_bnd.Size()==0)
@@ -255,13 +418,14 @@ public:
     cf_bnd_deriv = true;
   }
 
-  virtual void SetVectorField(shared_ptr<CoefficientFunction> cf)
+  virtual void SetVectorField(shared_ptr<CoefficientFunction> cf, bool cache)
   {
     throw Exception("SetVectorField just available for Advection equation");
   }
 
   virtual void SetMaterialParameters(shared_ptr<CoefficientFunction> cf_mu,
-                                     shared_ptr<CoefficientFunction> cf_eps)
+                                     shared_ptr<CoefficientFunction> cf_eps,
+                                     bool cache)
   {
     throw Exception("SetMaterialParameters just available for Wave equation");
   }
@@ -276,6 +440,31 @@ public:
     throw Exception("SetNumEntropyFlux just available for SymbolicConsLaw");
   }
 
+  virtual void SetNativeKernels(shared_ptr<CoefficientFunction> cf_flux,
+                                shared_ptr<CoefficientFunction> cf_numflux,
+                                shared_ptr<CoefficientFunction> cf_invmap)
+  {
+    throw Exception("SetNativeKernels just available for SymbolicConsLaw");
+  }
+
+  virtual void SetSource(shared_ptr<CoefficientFunction> cf_source,
+                         shared_ptr<CoefficientFunction> cf_dsource)
+  {
+    throw Exception("SetSource just available for SymbolicConsLaw");
+  }
+
+  // equations providing PositivityTheta set this to true
+  static constexpr bool HAS_POSITIVITY_LIMITER = false;
+
+  virtual void SetLimiter(bool positivity, bool bounds, bool viscosity)
+  {
+    if (positivity && !EQUATION::HAS_POSITIVITY_LIMITER)
+      throw Exception("positivity limiter not available for "+equation);
+    limit_positivity = positivity;
+    limit_bounds = bounds;
+    entropy_viscosity = viscosity;
+  }
+
   template <int W>
   void SolveM (const Tent & tent, int loci, FlatMatrixFixWidth<W> mat,
                LocalHeap & lh) const
@@ -293,7 +482,7 @@ public:
 	FlatVector<> diagmass(mat.Height(),lh);
 	fel.GetDiagMassMatrix(diagmass);
 
-	SIMD_IntegrationRule & ir = *fedata->iri[loci];
+	const SIMD_IntegrationRule & ir = *fedata->iri[loci];
 	SIMD_BaseMappedIntegrationRule & mir = *fedata->miri[loci];
 	FlatMatrix<SIMD<double>> pntvals(W, ir.Size(), lh);
 
@@ -340,7 +529,7 @@ public:
     FlatVector<> diagmass(mat.Height(),lh);
     fel.GetDiagMassMatrix(diagmass);
 
-    SIMD_IntegrationRule & ir = *fedata->iri[loci];
+    const SIMD_IntegrationRule & ir = *fedata->iri[loci];
     SIMD_BaseMappedIntegrationRule & mir = *fedata->miri[loci];
     FlatMatrix<SIMD<double>> pntvals(W, ir.Size(), lh);
 
@@ -359,6 +548,34 @@ public:
       mat.Row(i) /= diagmass(i);
   }
 
+  // multiply with the mass matrix that SolveM with delta inverts
+  template <int W>
+  void ApplyM (const Tent & tent, int loci,
+               FlatVector<SIMD<double>> delta,
+               FlatMatrixFixWidth<W> mat, LocalHeap & lh) const
+  {
+    auto fedata = tent.fedata;
+    if (!fedata)
+        throw Exception ("Expected tent.fedata to be set!");
+
+    HeapReset hr(lh);
+    auto & fel = static_cast<const BaseScalarFiniteElement&> (*fedata->fei[loci]);
+
+    const SIMD_IntegrationRule & ir = *fedata->iri[loci];
+    SIMD_BaseMappedIntegrationRule & mir = *fedata->miri[loci];
+    FlatMatrix<SIMD<double>> pntvals(W, ir.Size(), lh);
+
+    fel.Evaluate(ir, mat, pntvals);
+    for (int comp : Range(W))
+      {
+        for(int i : Range(ir))
+          pntvals(comp,i) *= ir[i].Weight() *
+            mir[i].GetMeasure() / delta(i);
+      }
+    mat = 0.0;
+    fel.AddTrans(ir,pntvals, mat);
+  }
+
   template <typename SCAL>
   Mat<COMP,DIM,SCAL> Flux (const BaseMappedIntegrationPoint & mip,
                            const FlatVec<COMP,SCAL> & u) const
@@ -401,6 +618,16 @@ public:
     throw Exception ("Transparent boundary just available for wave equation!");
   }
 
+  // allocate the ProxyUserData of a tent once, it is reused by all
+  // symbolic evaluations of its stages and substeps
+  void InitUserData (const Tent & tent, LocalHeap & lh) const;
+
+  // ProxyUserData with memory for u, uother and grad(phi) at the points
+  // of ir, attached to the trafo of tent element elnr
+  ProxyUserData & GetUserData (const Tent & tent, int elnr, bool facet,
+                               const SIMD_IntegrationRule & ir,
+                               LocalHeap & lh) const;
+
   void CalcFluxTent(const Tent & tent, const FlatMatrixFixWidth<COMP> u,
 		    FlatMatrixFixWidth<COMP> u0, FlatMatrixFixWidth<COMP> flux,
 		    double tstar, int derive_cf_bnd, LocalHeap & lh);
@@ -427,10 +654,20 @@ public:
     cout << "no overload for NumEntropyFlux for FlatMatrix<SIMD>" << endl;
   }
 
-  // apply viscosity
+  // apply viscosity, solvem=false skips the multiplication with M^{-1}
   void CalcViscosityTent (const Tent & tent, FlatMatrixFixWidth<COMP> u,
                           FlatMatrixFixWidth<COMP> ubnd, FlatVector<double> nu,
-                          FlatMatrixFixWidth<COMP> visc, LocalHeap & lh);
+                          FlatMatrixFixWidth<COMP> visc, LocalHeap & lh,
+                          bool solvem = true);
+
+  // one implicit Euler step u <- (M + tau A)^{-1} (M u + tau g) for the
+  // viscosity operator M^{-1}(A u - g) of CalcViscosityTent, solved by
+  // CG with the element-wise SolveM as preconditioner; returns the
+  // number of iterations
+  int SolveViscosityTent (const Tent & tent, FlatMatrixFixWidth<COMP> u,
+                          FlatMatrixFixWidth<COMP> ubnd, FlatVector<double> nu,
+                          double tau, LocalHeap & lh,
+                          double tol = 1e-8, int maxit = 100);
 
   // calculate entropy residual on a tent
   void CalcEntropyResidualTent (const Tent & tent, FlatMatrixFixWidth<COMP> u,
@@ -453,6 +690,80 @@ public:
     cout << "no overload for CalcViscCoeffEl with FlatMatrix<SIMD>" << endl;
   }
 
+  // Scaling limiter towards the element means of u = Cyl2Tent(uhat),
+  // u <- mean + theta (u - mean) component-wise on all elements of the
+  // tent, with theta such that the values at the integration points
+  //  - stay within the range of the element means of the tent (limit_bounds)
+  //  - are admissible states in the sense of PositivityTheta (limit_positivity).
+  // uhat is replaced by Tent2Cyl(u) with the element means of the old uhat,
+  // so the limiter is conservative. u is used as workspace.
+  // Returns false if no element was changed.
+  bool LimitTent (const Tent & tent, double tstar, FlatMatrixFixWidth<COMP> uhat,
+                  FlatMatrixFixWidth<COMP> u, LocalHeap & lh);
+
+  // reduce theta such that mean + theta (u - mean) is admissible at all
+  // points upts of an element, e.g. positive density and pressure
+  void PositivityTheta (FlatVector<> umean, FlatMatrix<SIMD<double>> upts,
+                        FlatVector<> theta) const
+  {
+    throw Exception ("PositivityTheta not implemented for " + equation);
+  }
+
+  // source s(u) at all points of an integration rule
+  void Source (const SIMD_BaseMappedIntegrationRule & mir,
+               FlatMatrix<SIMD<double>> u, FlatMatrix<SIMD<double>> s) const
+  {
+    throw Exception ("Source not implemented for " + equation);
+  }
+
+  // Jacobian ds/du, row COMP*i+j is ds_i/du_j; by default approximated
+  // by finite differences of Source
+  void SourceJacobian (const SIMD_BaseMappedIntegrationRule & mir,
+                       FlatMatrix<SIMD<double>> u,
+                       FlatMatrix<SIMD<double>> ds) const
+  {
+    STACK_ARRAY(SIMD<double>, mem, 3*COMP*mir.Size());
+    FlatMatrix<SIMD<double>> s0(COMP, mir.Size(), mem);
+    FlatMatrix<SIMD<double>> uh(COMP, mir.Size(), mem+COMP*mir.Size());
+    FlatMatrix<SIMD<double>> sh(COMP, mir.Size(), mem+2*COMP*mir.Size());
+    Cast().Source(mir, u, s0);
+    for (size_t j : Range(COMP))
+      {
+        uh = u;
+        for (size_t k : Range(mir.Size()))
+          uh(j,k) += 1e-7 * (1.0 + fabs(u(j,k)));
+        Cast().Source(mir, uh, sh);
+        for (size_t k : Range(mir.Size()))
+          for (size_t i : Range(COMP))
+            ds(COMP*i+j,k) = (sh(i,k) - s0(i,k)) / (uh(j,k) - u(j,k));
+      }
+  }
+
+  // one implicit Euler step of the source over the pseudo-time tau for
+  // the mapped variable ĝ(u) = u - ∇φ⋅f(u) at pseudo-time tstar,
+  //   ĝ(w) - tau δ s(w) = ĝ(u),
+  // at the integration points, followed by the L2 projection of w
+  void ImplicitSourceTent (const Tent & tent, double tstar, double tau,
+                           FlatMatrixFixWidth<COMP> u, LocalHeap & lh);
+
+  // true if hu is the solution u and one of the output slices crosses
+  // the tent, which has been initialized by InitTent
+  bool HasSlices (const Tent & tent, const BaseVector & hu) const;
+
+  Array<std::pair<string,double>> Timing(int reps, LocalHeap & lh);
+
+  // add the solution between the pseudo-times tstar0 and tstar1 (linear
+  // in τ) on the parts of the output slices in this range to the right
+  // hand sides of their L2 projections
+  void SliceTent (const Tent & tent, double tstar0, double tstar1,
+                  FlatMatrixFixWidth<COMP> uhat0, FlatMatrixFixWidth<COMP> uhat1,
+                  LocalHeap & lh);
+
+  // append the solution at pseudo-time tstar to the probes in the tent,
+  // if hu is the solution u (not an ensemble member)
+  void RecordProbes (const Tent & tent, const BaseVector & hu, double tstar,
+                     FlatMatrixFixWidth<COMP> uhat, LocalHeap & lh);
+
   ////////////////////////////////////////////////////////////////
   // maps 
   ////////////////////////////////////////////////////////////////
@@ -488,6 +799,12 @@ public:
     else if(method == "SARK")
       tentsolver = make_shared<SARK<T_ConservationLaw<EQUATION,DIM,COMP,ECOMP,SYMBOLIC>>>
 	(this->shared_from_this(), stages, substeps);
+    else if(method == "LSSARK")
+      tentsolver = make_shared<LSSARK<T_ConservationLaw<EQUATION,DIM,COMP,ECOMP,SYMBOLIC>>>
+	(this->shared_from_this(), stages, substeps);
+    else if(method == "IMEX")
+      tentsolver = make_shared<IMEX<T_ConservationLaw<EQUATION,DIM,COMP,ECOMP,SYMBOLIC>>>
+	(this->shared_from_this(), stages, substeps);
     else
       throw Exception("unknown TentSolver "+method);
   }
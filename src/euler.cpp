@@ -2,6 +2,9 @@
 using namespace ngsolve;
 
 #include "tconservationlaw_tp_impl.hpp"
+#ifdef NGSTENTS_TESTING
+#include <random>
+#endif
 
 double dim_ = 5; // degrees of freedom of gas molecules
 double gamma_ = 1.4; // (dim_+2)/dim_
@@ -24,7 +27,23 @@ double erf(double x)
     * exp (-x * x);
 }
 
-inline void Int_x_infty (double x, double & int0, double & int1, double & int2, double & int3)
+SIMD<double> erf(SIMD<double> x)
+{
+  // same approximation as above, evaluated on all lanes at once
+  SIMD<double> ax = IfPos(x, x, -x);
+  SIMD<double> y = 1.0 / ( 1.0 + 0.3275911 * ax);
+  SIMD<double> res = 1.0 - (((((
+                                + 1.061405429 * y
+                                - 1.453152027) * y
+                               + 1.421413741) * y
+                              - 0.284496736) * y
+                             + 0.254829592) * y)
+    * exp (-ax * ax);
+  return IfPos(x, res, -res);
+}
+
+template <typename SCAL>
+inline void Int_x_infty (SCAL x, SCAL & int0, SCAL & int1, SCAL & int2, SCAL & int3)
 {
   // int_x^\infty  exp(-v^2) v^i dv
   
@@ -104,7 +123,9 @@ public:
       }
   }
 
-  Vec<D+2> NumFlux (Vec<D+2> ul, Vec<D+2> ur, Vec<D> n) const
+  // kinetic flux, SCAL = double or SIMD<double>
+  template <typename SCAL>
+  Vec<D+2,SCAL> NumFlux (Vec<D+2,SCAL> ul, Vec<D+2,SCAL> ur, Vec<D,SCAL> n) const
     {
       /* // cout << "ul, ur = " << ul << ", " << ur << endl;
       // left value
@@ -123,47 +144,38 @@ public:
       return 0.5 * (Flux(ul)*n + Flux(ur)*n) + L2Norm(n) * 0.5*max(betar,betal) * (ul-ur);
       // return 0.5 * (Flux(ul)*n + Flux(ur)*n) + L2Norm(n) * (ul-ur);
       */
-      Vec<D+2> h = 0.0;
+      Vec<D+2,SCAL> h = SCAL(0.0);
       
       double dim = dim_;
       
       for (int side = 0; side < 2; side++)
 	{
-	  Vec<D+2> ut = (side == 0) ? ul : ur;
-	  Vec<D> ntn = (side == 0) ? n : Vec<D>(-n);
-	  double fac = (side == 0) ? 1 : -1;
+	  Vec<D+2,SCAL> ut = (side == 0) ? ul : ur;
+	  Vec<D,SCAL> ntn = (side == 0) ? n : Vec<D,SCAL>(-n);
+	  double sign = (side == 0) ? 1 : -1;
 	  
-	  double len = L2Norm (n);
-	  ntn /= len;
+	  SCAL len = sqrt (L2Norm2 (n));
+	  ntn *= 1.0/len;
 	  
-	  double rho = ut(0);
-	  Vec<D> U = 1/rho * ut.Range(1,D+1);
+	  SCAL rho = ut(0);
+	  Vec<D,SCAL> U = 1.0/rho * ut.Range(1,D+1);
 	  
-	  double un = InnerProduct (U, ntn);
-	  double normu2 = L2Norm2 (U);
+	  SCAL un = InnerProduct (U, ntn);
+	  SCAL normu2 = L2Norm2 (U);
 	  
-	  double e = ut(D+1)/rho - 0.5 * normu2;
+	  SCAL e = ut(D+1)/rho - 0.5 * normu2;
 	  
-	  double T = 4.0/dim * e;
+	  SCAL T = 4.0/dim * e;
 	  
-	  if (T <= 0)
-	    {
-	      // cout << "T correction" << endl;
-	      T = 1e-10;
-	    }
+	  // T correction
+	  T = IfPos(T, T, SCAL(1e-10));
 	  
-	  if (rho <= 0)
-	    {
-	      // throw Exception ("rho negative");
-	      // cout << "rho negative" << endl;
-	    }
+	  SCAL sqrtT = sqrt(T);
 	  
-	  double sqrtT = sqrt(T);
-	  
-	  double i0, i1, i2, i3;
+	  SCAL i0, i1, i2, i3;
 	  Int_x_infty (-un/sqrtT, i0, i1, i2, i3);
 	  
-	  fac *= len * rho / sqrt(M_PI);
+	  SCAL fac = sign * len * rho / sqrt(M_PI);
 	  
 	  h(0) += fac * (un*i0 + sqrtT*i1);
 	  
@@ -181,23 +193,13 @@ public:
   void NumFlux(FlatMatrix<SIMD<double>> ula, FlatMatrix<SIMD<double>> ura,
             FlatMatrix<SIMD<double>> normals, FlatMatrix<SIMD<double>> fna) const
   {
-    // TODO: proper use of SIMD!
     for (size_t i : Range(ula.Width()))
-      for (size_t j : Range(SIMD<double>::Size()))
-        {
-          Vec<D+2> ul, ur;
-          Vec<D> n;
-          for (size_t k : Range(D+2))
-            {
-              ul(k) = ula(k,i)[j];
-              ur(k) = ura(k,i)[j];
-            }
-          for (size_t k : Range(D))
-            n(k) = normals(k,i)[j];
-          Vec<D+2> fn = NumFlux(ul,ur,n);
-          for (size_t k : Range(D+2))
-            reinterpret_cast<double*>(&fna(k,i))[j] = fn(k);
-        }
+      {
+        Vec<D+2,SIMD<double>> ul = ula.Col(i);
+        Vec<D+2,SIMD<double>> ur = ura.Col(i);
+        Vec<D,SIMD<double>> n = normals.Col(i);
+        fna.Col(i) = NumFlux(ul, ur, n);
+      }
   }
 
   void NumFlux(const SIMD_BaseMappedIntegrationRule & mir,
@@ -207,17 +209,18 @@ public:
     NumFlux (ul, ur, normals, fna);
   }
 
-  void u_reflect(Vec<D+2> U, Vec<D> n, Vec<D+2> & U_refl) const
+  template <typename SCAL>
+  void u_reflect(Vec<D+2,SCAL> U, Vec<D,SCAL> n, Vec<D+2,SCAL> & U_refl) const
   {
-    double rho = U(0);
-    Vec<D> u = 1/rho * U.Range(1,D+1);
-    double E = U(D+1) / rho;
-    double e = E - 0.5 * L2Norm2(u);
+    SCAL rho = U(0);
+    Vec<D,SCAL> u = 1.0/rho * U.Range(1,D+1);
+    SCAL E = U(D+1) / rho;
+    SCAL e = E - 0.5 * L2Norm2(u);
     
-    Vec<D> nn = n;
-    nn /= L2Norm(n);
+    Vec<D,SCAL> nn = n;
+    nn *= 1.0/sqrt(L2Norm2(n));
     
-    Vec<D> u_refl = u - 2 * InnerProduct(nn, u) * nn;
+    Vec<D,SCAL> u_refl = u - 2 * InnerProduct(nn, u) * nn;
 
     U_refl(0) = rho; 
     U_refl.Range(1,D+1) = rho * u_refl;
@@ -231,18 +234,11 @@ public:
   {
     for(auto i : Range(u.Width()))
       {
-        for (size_t j : Range(SIMD<double>::Size()))
-          {
-            Vec<D+2> uvec, uvec_refl;
-            for(auto k : Range(D+2))
-              uvec(k) = u(k,i)[j];
-            Vec<D> n;
-            for(auto k : Range(D))
-              n(k) = normals(k,i)[j];
-            u_reflect(uvec,n,uvec_refl);
-            for(auto k : Range(D+2))
-              reinterpret_cast<double*>(&u_refl(k,i))[j] = uvec_refl(k);
-          }
+        Vec<D+2,SIMD<double>> uvec = u.Col(i);
+        Vec<D,SIMD<double>> n = normals.Col(i);
+        Vec<D+2,SIMD<double>> uvec_refl;
+        u_reflect(uvec, n, uvec_refl);
+        u_refl.Col(i) = uvec_refl;
       }
   }
 
@@ -419,7 +415,7 @@ public:
     
     u2pUT(u, pUT, lh);
     
-    FlatVector<> vecU(2*ndof_total, lh);
+    FlatVector<> vecU(D*ndof_total, lh);
     for(int l = 0; l < ndof_total; l++)
       for(int m = 0; m < D; m++)
 	vecU(D*l+m) = pUT(l,m+1);
@@ -431,6 +427,53 @@ public:
     gfmach->GetVector().FVDouble() = pUT.Col(D+2);
   }
 
+  static constexpr bool HAS_POSITIVITY_LIMITER = true;
+
+  // Zhang-Shu scaling: first limit the density to rho >= eps, then, by
+  // concavity of the pressure in the conserved variables, scale all
+  // components towards the mean to get p >= eps
+  void PositivityTheta (FlatVector<> umean, FlatMatrix<SIMD<double>> upts,
+                        FlatVector<> theta) const
+  {
+    double rhomean = umean(0);
+    double pmean = 2.0/dim_ * (umean(D+1) - 0.5*L2Norm2(umean.Range(1,D+1))/rhomean);
+    if (rhomean <= 0 || pmean <= 0)
+      {
+        // the mean itself is not admissible, the best we can do
+        theta = 0.0;
+        return;
+      }
+    double eps = min(1e-13, min(rhomean, pmean));
+
+    SIMD<double> th1(1.0);
+    for (size_t k : Range(upts.Width()))
+      {
+        auto rho = upts(0,k);
+        th1 = IfPos(eps - rho, min(th1, (rhomean-eps)/(rhomean-rho)), th1);
+      }
+    double theta1 = 1.0;
+    for (size_t l : Range(SIMD<double>::Size()))
+      theta1 = min(theta1, th1[l]);
+
+    SIMD<double> th2(1.0);
+    for (size_t k : Range(upts.Width()))
+      {
+        auto rho = rhomean + theta1 * (upts(0,k) - rhomean);
+        SIMD<double> normm2 = 0.0;
+        for (size_t l : Range(D))
+          normm2 += upts(l+1,k)*upts(l+1,k);
+        auto p = 2.0/dim_ * (upts(D+1,k) - 0.5*normm2/rho);
+        th2 = IfPos(eps - p, min(th2, (pmean-eps)/(pmean-p)), th2);
+      }
+    double theta2 = 1.0;
+    for (size_t l : Range(SIMD<double>::Size()))
+      theta2 = min(theta2, th2[l]);
+
+    theta(0) *= theta1 * theta2;
+    for (size_t c : Range(1,D+2))
+      theta(c) *= theta2;
+  }
+
   template <typename MIP=BaseMappedIntegrationPoint, typename TA, typename TB>
   void InverseMap(const MIP & mip, const TA & grad,
 		  const TB & u) const
@@ -474,6 +517,88 @@ public:
       InverseMap(mir[i], grad.Col(i), u.Col(i));
   }
 
+#ifdef NGSTENTS_TESTING
+  // Largest relative differences of the SIMD and the scalar versions of
+  // erf, NumFlux and u_reflect on n random states, including states near
+  // vacuum (tiny rho and T) and states with e < 0 (T correction).
+  Vec<3> CompareSIMD (int n, unsigned seed) const
+  {
+    constexpr int W = SIMD<double>::Size();
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<double> unif(0, 1);
+    auto random_state = [&] (Vec<D+2> & U)
+      {
+        double rho = pow(10.0, -12 + 13*unif(gen));
+        double T = pow(10.0, -12 + 13*unif(gen));
+        double mach = 3*unif(gen);
+        Vec<D> vel;
+        for (int j = 0; j < D; j++)
+          vel(j) = 2*unif(gen)-1;
+        vel *= mach*sqrt(gamma_*T) / max(L2Norm(vel), 1e-14);
+        double e = dim_/4 * T;
+        if (unif(gen) < 0.1)
+          e = -e;
+        U(0) = rho;
+        U.Range(1,D+1) = rho * vel;
+        U(D+1) = rho * (e + 0.5*L2Norm2(vel));
+      };
+    auto relerr = [] (auto a, auto b)
+      {
+        double diff = 0, norm = 1e-300;
+        for (size_t k : Range(b.Size()))
+          {
+            diff = max(diff, abs(a(k)-b(k)));
+            norm = max(norm, abs(b(k)));
+          }
+        return diff/norm;
+      };
+
+    Vec<3> err = 0.0;
+    for (int i = 0; i < n; i += W)
+      {
+        Vec<D+2> ul[W], ur[W];
+        Vec<D> nv[W];
+        double x[W];
+        for (int l = 0; l < W; l++)
+          {
+            random_state(ul[l]);
+            random_state(ur[l]);
+            for (int j = 0; j < D; j++)
+              nv[l](j) = 2*unif(gen)-1;
+            x[l] = 10*unif(gen)-5;
+          }
+        Vec<D+2,SIMD<double>> simd_ul, simd_ur, simd_flux, simd_refl;
+        Vec<D,SIMD<double>> simd_n;
+        for (int k = 0; k < D+2; k++)
+          {
+            simd_ul(k) = SIMD<double>([&](int l) { return ul[l](k); });
+            simd_ur(k) = SIMD<double>([&](int l) { return ur[l](k); });
+          }
+        for (int j = 0; j < D; j++)
+          simd_n(j) = SIMD<double>([&](int l) { return nv[l](j); });
+        SIMD<double> simd_erf = erf(SIMD<double>([&](int l) { return x[l]; }));
+        simd_flux = NumFlux(simd_ul, simd_ur, simd_n);
+        u_reflect(simd_ul, simd_n, simd_refl);
+
+        for (int l = 0; l < W; l++)
+          {
+            Vec<1> erf_l = erf(x[l]), simd_erf_l = simd_erf[l];
+            Vec<D+2> flux = NumFlux(ul[l], ur[l], nv[l]);
+            Vec<D+2> refl, simd_flux_l, simd_refl_l;
+            u_reflect(ul[l], nv[l], refl);
+            for (int k = 0; k < D+2; k++)
+              {
+                simd_flux_l(k) = simd_flux(k)[l];
+                simd_refl_l(k) = simd_refl(k)[l];
+              }
+            err(0) = max(err(0), relerr(simd_erf_l, erf_l));
+            err(1) = max(err(1), relerr(simd_flux_l, flux));
+            err(2) = max(err(2), relerr(simd_refl_l, refl));
+          }
+      }
+    return err;
+  }
+#endif // NGSTENTS_TESTING
 };
 
 /////////////////////////////////////////////////////////////////////////
@@ -487,6 +612,21 @@ shared_ptr<ConservationLaw> CreateEuler(const shared_ptr<GridFunction> & gfu,
     return make_shared<Euler<1>>(gfu, tps);
   case 2:
     return make_shared<Euler<2>>(gfu, tps);
+  case 3:
+    return make_shared<Euler<3>>(gfu, tps);
   }
-  throw Exception ("euler only available for 1D and 2D");
+  throw Exception ("Illegal dimension for Euler");
+}
+
+#ifdef NGSTENTS_TESTING
+Vec<3> EulerCompareSIMD(const shared_ptr<ConservationLaw> & cl, int n, unsigned seed)
+{
+  if (auto eu = dynamic_pointer_cast<Euler<1>>(cl))
+    return eu->CompareSIMD(n, seed);
+  if (auto eu = dynamic_pointer_cast<Euler<2>>(cl))
+    return eu->CompareSIMD(n, seed);
+  if (auto eu = dynamic_pointer_cast<Euler<3>>(cl))
+    return eu->CompareSIMD(n, seed);
+  throw Exception ("not an Euler conservation law");
 }
+#endif // NGSTENTS_TESTING
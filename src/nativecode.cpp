@@ -0,0 +1,231 @@
+#include "nativecode.hpp"
+#include "tents.hpp"   // TraverseDimensions_old
+#include <fstream>
+#include <random>
+#include <future>
+
+
+std::filesystem::path NativeCacheDirectory ()
+{
+  if (auto dir = getenv("NGSTENTS_CACHE_DIR"))
+    return dir;
+  if (auto home = getenv("HOME"))
+    return std::filesystem::path(home) / ".cache" / "ngstents";
+  return std::filesystem::temp_directory_path() / "ngstents";
+}
+
+
+static string GenerateKernelCode (shared_ptr<CoefficientFunction> cf,
+                                  FlatArray<CoefficientFunction*> inputs)
+{
+  // all nodes of the expression tree in topological order
+  Array<CoefficientFunction*> steps;
+  cf->TraverseTree ([&] (CoefficientFunction & stepcf)
+                    {
+                      if (!steps.Contains (&stepcf))
+                        steps.Append (&stepcf);
+                    });
+
+  Code code;
+  code.is_simd = true;
+  code.deriv = 0;
+  for (int i : Range(steps))
+    {
+      auto pos = inputs.Pos(steps[i]);
+      if (pos != inputs.ILLEGAL_POSITION)
+        {
+          // read values from the kernel arguments instead of ProxyUserData
+          TraverseDimensions_old
+            (steps[i]->Dimensions(), [&](int ind, int j, int k)
+             {
+               code.body += Var(i,j,k).Assign
+                 (CodeExpr("args["+ToLiteral(pos)+"]("+ToLiteral(ind)+",i)"));
+             });
+          continue;
+        }
+      Array<int> stepinputs;
+      for (auto incf : steps[i]->InputCoefficientFunctions())
+        stepinputs.Append (steps.Pos(incf.get()));
+      steps[i]->GenerateCode(code, stepinputs, i);
+    }
+
+  string results;
+  TraverseDimensions_old
+    (cf->Dimensions(), [&](int ind, int j, int k)
+     {
+       results += "results("+ToLiteral(ind)+",i) = "
+         + Var(steps.Size()-1,j,k).S() + ";\n";
+     });
+
+  string s;
+  s += "#include <fem.hpp>\n";
+  s += "using namespace ngfem;\n\n";
+  s += code.top;
+  s += "\nextern \"C\" void ngstents_kernel"
+    "(SIMD_BaseMappedIntegrationRule & mir,\n"
+    "                                FlatMatrix<SIMD<double>> * args,\n"
+    "                                BareSliceMatrix<SIMD<double>> results)\n";
+  s += "{\n";
+  s += "  [[maybe_unused]] auto points = mir.GetPoints();\n";
+  s += "  [[maybe_unused]] auto domain_index = mir.GetTransformation().GetElementIndex();\n";
+  s += code.header;
+  s += "  for (size_t i = 0; i < mir.Size(); i++)\n";
+  s += "  {\n";
+  s += "  [[maybe_unused]] auto & ip = mir[i];\n";
+  s += code.body;
+  s += results;
+  s += "  }\n";
+  s += "}\n";
+  // coefficients referring to objects of this process (grid functions,
+  // parameters) make the library specific to this run: the addresses are
+  // part of the source and thus of its hash
+  if (code.pointer.size())
+    s += "\nextern \"C\" {\n" + code.pointer + "}\n";
+  return s;
+}
+
+
+std::filesystem::path CompileCached (const string & name, const string & source,
+                                     const string & compile_flags,
+                                     const string & link_flags,
+                                     FlatArray<std::filesystem::path> depends)
+{
+  namespace fs = std::filesystem;
+  const string compile_cmd = "ngscxx -c " + compile_flags;
+  const string link_cmd = "ngsld -shared";
+
+  // the compiler commands, the NGSolve version and the contents of the
+  // headers the source includes are part of the key, so that a library
+  // built against other headers is never loaded
+  string keysource = source + compile_cmd + link_cmd + link_flags
+    + GetLibraryVersion("ngsolve").to_string();
+  for (auto & file : depends)
+    {
+      std::ifstream in(file, std::ios::binary);
+      if (!in)
+        throw Exception ("cannot read " + file.string());
+      std::stringstream contents;
+      contents << in.rdbuf();
+      keysource += file.filename().string() + contents.str();
+    }
+  std::stringstream key;
+  key << std::hex << std::hash<string>{}(keysource);
+
+  auto dir = NativeCacheDirectory();
+  fs::create_directories(dir);
+  auto libfile = dir / (name + "_" + key.str() + ".so");
+  if (fs::exists(libfile))
+    return libfile;
+
+  // build under a unique name and move it into place, so that
+  // concurrent processes never load a half-written library
+  auto tmpname = dir / ("tmp_" + key.str() + "_"
+                        + ToString(std::random_device{}()));
+  auto srcfile = tmpname; srcfile += ".cpp";
+  auto objfile = tmpname; objfile += ".o";
+  auto tmplib = tmpname; tmplib += ".so";
+  {
+    std::ofstream out(srcfile);
+    out << source;
+  }
+  string scompile = compile_cmd + " " + srcfile.string()
+    + " -o " + objfile.string();
+  string slink = link_cmd + " " + objfile.string()
+    + " -o " + tmplib.string() + " " + link_flags;
+  int err = system(scompile.c_str());
+  if (!err)
+    err = system(slink.c_str());
+  fs::remove(objfile);
+  if (err)
+    throw Exception ("compilation of " + name + " failed, source in "
+                     + srcfile.string());
+  fs::rename(srcfile, fs::path(libfile).replace_extension(".cpp"));
+  fs::rename(tmplib, libfile);
+  return libfile;
+}
+
+
+NativeKernel :: NativeKernel (shared_ptr<CoefficientFunction> cf,
+                              FlatArray<CoefficientFunction*> inputs)
+{
+  source = GenerateKernelCode(cf, inputs);
+  auto libfile = CompileCached("kernel", source, "",
+                               "-lngfem -lngbla -lngstd -lngcore");
+  library = make_unique<SharedLibrary>(libfile);
+  func = library->GetFunction<TFunc>("ngstents_kernel");
+  if (!func)
+    throw Exception ("NativeKernel: could not load kernel from "
+                     + libfile.string());
+}
+
+
+NativeCoefficientFunction ::
+NativeCoefficientFunction (shared_ptr<CoefficientFunction> acf)
+  : CoefficientFunction(acf->Dimension(), acf->IsComplex()), cf(acf)
+{
+  SetDimensions(cf->Dimensions());
+
+  // inputs provided through ProxyUserData
+  Array<CoefficientFunction*> inputs;
+  cf->TraverseTree ([&] (CoefficientFunction & nodecf)
+                    {
+                      if (auto proxy = dynamic_cast<ProxyFunction*>(&nodecf))
+                        {
+                          if (!proxies.Contains(proxy))
+                            proxies.Append(proxy);
+                        }
+                      else if (dynamic_cast<GradPhiCoefficientFunction*>(&nodecf))
+                        {
+                          if (!cfs.Contains(&nodecf))
+                            cfs.Append(&nodecf);
+                        }
+                    });
+  for (auto proxy : proxies)
+    inputs.Append (const_cast<ProxyFunction*>(proxy));
+  for (auto incf : cfs)
+    inputs.Append (const_cast<CoefficientFunction*>(incf));
+
+  compiling = std::async(std::launch::async, [this, inputs] ()
+                         {
+                           kernel = make_unique<NativeKernel>(cf, inputs);
+                         }).share();
+}
+
+void NativeCoefficientFunction ::
+Evaluate (const SIMD_BaseMappedIntegrationRule & mir,
+          BareSliceMatrix<SIMD<double>> values) const
+{
+  compiling.get();   // rethrows compile errors
+
+  auto ud = static_cast<ProxyUserData*>(mir.GetTransformation().userdata);
+  ArrayMem<FlatMatrix<SIMD<double>>, 8> args(proxies.Size()+cfs.Size());
+  for (auto i : Range(proxies))
+    {
+      if (!ud || !ud->HasMemory(proxies[i]))
+        {
+          cf->Evaluate(mir, values);
+          return;
+        }
+      auto mem = ud->GetAMemory(proxies[i]);
+      args[i].AssignMemory(mem.Height(), mem.Width(), mem.Data());
+    }
+  for (auto i : Range(cfs))
+    {
+      if (!ud || !ud->HasMemory(cfs[i]))
+        {
+          cf->Evaluate(mir, values);
+          return;
+        }
+      auto mem = ud->GetAMemory(cfs[i]);
+      args[proxies.Size()+i].AssignMemory(mem.Height(), mem.Width(), mem.Data());
+    }
+  (*kernel)(mir, args.Data(), values);
+}
+
+shared_ptr<CoefficientFunction> NativeCompile (shared_ptr<CoefficientFunction> cf,
+                                               bool realcompile)
+{
+  if (realcompile)
+    return make_shared<NativeCoefficientFunction>(cf);
+  return Compile(cf, false, 0);
+}
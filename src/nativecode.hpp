@@ -0,0 +1,123 @@
+#ifndef NATIVECODE_HPP
+#define NATIVECODE_HPP
+
+#include <solve.hpp>
+using namespace ngsolve;
+
+
+////////////////////////////////////////////////////////////////////////////
+///
+/// A CoefficientFunction translated into a native C++ kernel
+///
+///    results(:,i) = cf(args[0](:,i), args[1](:,i), ...)
+///
+/// for all points i of a SIMD mapped integration rule.  The coefficient
+/// functions listed in "inputs" (proxies, grad(φ), ...) are not evaluated
+/// through ProxyUserData but read directly from the argument matrices.
+///
+/// The generated code is compiled with ngscxx/ngsld into a shared library
+/// which is kept in a cache directory ($NGSTENTS_CACHE_DIR, default
+/// ~/.cache/ngstents) and named after the hash of its source, so that
+/// later runs with the same expressions skip the compilation.  Grid
+/// functions and parameters in cf are referred to by their addresses in
+/// this process, which become part of the source: such kernels are
+/// reused only within the same process.
+///
+/// SymbolicConsLaw calls NativeKernels directly for flux, numerical flux
+/// and inverse map (native=True).  Any other CF, and these three with
+/// compile=True only, is wrapped in a NativeCoefficientFunction below.
+///
+class NativeKernel
+{
+public:
+  typedef void (*TFunc) (SIMD_BaseMappedIntegrationRule & mir,
+                         FlatMatrix<SIMD<double>> * args,
+                         BareSliceMatrix<SIMD<double>> results);
+
+  NativeKernel (shared_ptr<CoefficientFunction> cf,
+                FlatArray<CoefficientFunction*> inputs);
+
+  void operator() (const SIMD_BaseMappedIntegrationRule & mir,
+                   FlatMatrix<SIMD<double>> * args,
+                   BareSliceMatrix<SIMD<double>> results) const
+  {
+    func(const_cast<SIMD_BaseMappedIntegrationRule&>(mir), args, results);
+  }
+
+  /// the generated source code
+  const string & Source() const { return source; }
+
+private:
+  string source;
+  unique_ptr<SharedLibrary> library;
+  TFunc func = nullptr;
+};
+
+/// Directory of the compiled kernels
+std::filesystem::path NativeCacheDirectory ();
+
+/// Compile source with ngscxx/ngsld into a shared library in the cache
+/// directory, unless a library for the same source, flags, NGSolve version
+/// and contents of the files in depends (the included headers) exists
+/// already, and return its path.
+std::filesystem::path CompileCached (const string & name, const string & source,
+                                     const string & compile_flags,
+                                     const string & link_flags,
+                                     FlatArray<std::filesystem::path> depends
+                                     = FlatArray<std::filesystem::path>());
+
+
+////////////////////////////////////////////////////////////////////////////
+///
+/// Compiled version of a CoefficientFunction of a symbolic conservation
+/// law.  Proxies and grad(φ) are read from the ProxyUserData of the
+/// trafo and passed to a NativeKernel, hence they do not make the code
+/// depend on addresses of this process; unless cf contains grid functions
+/// or parameters (see NativeKernel), the library is reused from the
+/// on-disk cache in later runs.  The kernel is built in a background
+/// thread (several CFs compile in parallel), the first SIMD evaluation
+/// waits for it.  Other evaluations use the original CoefficientFunction.
+///
+class NativeCoefficientFunction : public CoefficientFunction
+{
+  shared_ptr<CoefficientFunction> cf;
+  Array<const ProxyFunction*> proxies;    ///< kernel arguments 0, 1, ...
+  Array<const CoefficientFunction*> cfs;  ///< followed by these
+  unique_ptr<NativeKernel> kernel;
+  std::shared_future<void> compiling;
+
+public:
+  NativeCoefficientFunction (shared_ptr<CoefficientFunction> acf);
+
+  double Evaluate (const BaseMappedIntegrationPoint & ip) const
+  { return cf->Evaluate(ip); }
+
+  void Evaluate (const BaseMappedIntegrationPoint & ip,
+                 FlatVector<> values) const
+  { cf->Evaluate(ip, values); }
+
+  void Evaluate (const BaseMappedIntegrationRule & mir,
+                 BareSliceMatrix<double> values) const
+  { cf->Evaluate(mir, values); }
+
+  void Evaluate (const SIMD_BaseMappedIntegrationRule & mir,
+                 BareSliceMatrix<SIMD<double>> values) const;
+
+  void TraverseTree (const function<void(CoefficientFunction&)> & func)
+  {
+    cf->TraverseTree(func);
+    func(*this);
+  }
+
+  shared_ptr<CoefficientFunction>
+  Diff (const CoefficientFunction * var,
+        shared_ptr<CoefficientFunction> dir) const
+  { return cf->Diff(var, dir); }
+};
+
+/// NativeCoefficientFunction if realcompile is set, the step-wise
+/// evaluation of ngsolve's Compile otherwise
+shared_ptr<CoefficientFunction> NativeCompile (shared_ptr<CoefficientFunction> cf,
+                                               bool realcompile);
+
+#endif // NATIVECODE_HPP
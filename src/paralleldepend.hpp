@@ -41,23 +41,23 @@ void RunParallelDependency (const Table<int> & dag, TFUNC func)
     }
 
 
-  /*
-    while (ready.Size())
-    {
-    int size = ready.Size();
-    int nr = ready[size-1];
-    ready.SetSize(size-1);
-
-    func(nr);
-
-    for (int j : dag[nr])
+  // without task manager (background jobs, calls outside of a
+  // TaskManager context): in the order of the dependencies
+  if (!task_manager)
     {
-    cnt_dep[j]--;
-    if (cnt_dep[j] == 0)
-    ready.Append(j);
-    }
+      while (ready.Size())
+        {
+          int nr = ready.Last();
+          ready.DeleteLast();
+
+          func(nr);
+
+          for (int j : dag[nr])
+            if (--cnt_dep[j] == 0)
+              ready.Append(j);
+        }
+      return;
     }
-  */
 
 
   atomic<int> cnt_final(0);
@@ -0,0 +1,86 @@
+#ifndef PYTHON_ASYNC_HPP
+#define PYTHON_ASYNC_HPP
+
+#include <future>
+#include <chrono>
+#include <mutex>
+#include <python_ngstd.hpp>
+
+// Parallel ngstents work started from Python is serialized by this
+// mutex (defined in python_tents.cpp): an AsyncResult holds it while its
+// job runs, the blocking bindings (Propagate, PitchTents, ...) take it
+// through ParallelWorkGuard.  Recursive, since callbacks of
+// PropagateUntil may call other bindings.
+std::recursive_mutex & ParallelWorkMutex ();
+
+// call guard of blocking bindings: release the GIL, then wait for
+// running background jobs
+struct ParallelWorkGuard
+{
+  py::gil_scoped_release release;
+  std::lock_guard<std::recursive_mutex> lock{ParallelWorkMutex()};
+};
+
+// Handle of a computation running in a background thread without the
+// GIL (PitchTentsAsync, PropagateAsync).  ngcore has a single, global
+// task manager, which belongs to the thread that started it: the
+// background thread does not start one (the loops of ngstents run
+// sequentially there), so that Python can meanwhile do I/O and NGSolve
+// work outside of a TaskManager context.  Jobs are started outside of
+// a TaskManager context and serialized with the blocking bindings by
+// ParallelWorkMutex.
+class AsyncResult
+{
+  std::shared_future<bool> future;
+
+public:
+  AsyncResult (std::function<bool()> func)
+  {
+    if (ngcore::task_manager)
+      throw ngcore::Exception("background computations run without task manager, "
+                              "start them outside of a TaskManager context");
+    future = std::async(std::launch::async, [func] ()
+      {
+        std::lock_guard<std::recursive_mutex> lock(ParallelWorkMutex());
+        if (ngcore::task_manager)
+          throw ngcore::Exception("a TaskManager context was entered while the "
+                                  "background computation was waiting to start");
+        return func();
+      }).share();
+  }
+
+  bool Done () const
+  {
+    return future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+  }
+
+  // wait at most timeout seconds (forever if negative), returns Done()
+  bool Wait (double timeout) const
+  {
+    if (timeout < 0)
+      future.wait();
+    else
+      future.wait_for(std::chrono::duration<double>(timeout));
+    return Done();
+  }
+
+  // waits, rethrows an exception of the computation
+  bool Result () const { return future.get(); }
+};
+
+inline void ExportAsyncResult (py::module & m)
+{
+  py::class_<AsyncResult, shared_ptr<AsyncResult>>
+    (m, "AsyncResult", "Handle of a computation running in the background")
+    .def("done", &AsyncResult::Done, "True if the computation has finished")
+    .def("wait", &AsyncResult::Wait, py::arg("timeout") = -1.0,
+         py::call_guard<py::gil_scoped_release>(),
+         "Wait for the computation, at most timeout seconds if timeout >= 0.\n"
+         "Returns True if it has finished")
+    .def("result", &AsyncResult::Result,
+         py::call_guard<py::gil_scoped_release>(),
+         "Wait for the computation and return its result, exceptions of the\n"
+         "computation are raised here");
+}
+
+#endif // PYTHON_ASYNC_HPP
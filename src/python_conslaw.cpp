@@ -1,5 +1,9 @@
 #include "conservationlaw.hpp"
+#include "nativecode.hpp"
+#include "vtuwriter.hpp"
+#include "python_async.hpp"
 #include <python_ngstd.hpp>
+#include <pybind11/numpy.h>
 
 shared_ptr<ConservationLaw> CreateBurgers(const shared_ptr<GridFunction> & gfu,
 					  const shared_ptr<TentPitchedSlab> & tps);
@@ -11,6 +15,9 @@ shared_ptr<ConservationLaw> CreateAdvection(const shared_ptr<GridFunction> & gfu
 					    const shared_ptr<TentPitchedSlab> & tps);
 shared_ptr<ConservationLaw> CreateMaxwell(const shared_ptr<GridFunction> & gfu,
 					  const shared_ptr<TentPitchedSlab> & tps);
+#ifdef NGSTENTS_TESTING
+Vec<3> EulerCompareSIMD(const shared_ptr<ConservationLaw> & cl, int n, unsigned seed);
+#endif
 
 typedef CoefficientFunction CF;
 shared_ptr<ConservationLaw>
@@ -89,9 +96,16 @@ void ExportConsLaw(py::module & m)
 		     optional<py::object> Entropy,
 		     optional<py::object> EntropyFlux,
 		     optional<py::object> NumEntropyFlux,
-		     optional<py::object> ViscosityCoefficient)
+		     optional<py::object> ViscosityCoefficient,
+		     const bool native)
      		  -> shared_ptr<CL>
 		  {
+		    // compile: every CF is wrapped in a NativeCoefficientFunction,
+		    //   proxies are read from ProxyUserData
+		    // native: flux, numflux and inverse map become NativeKernels
+		    //   which take u, u.Other() and grad(phi) as arguments; they
+		    //   replace the compiled CFs, which are not built then
+
 		    // proxies for u and u.Other()
      		    py::object u = py::cast (gfu->GetFESpace()).attr("TrialFunction")();
 		    py::object uother = u.attr("Other")();
@@ -100,19 +114,25 @@ void ExportConsLaw(py::module & m)
 		    py::object flux_u = Flux( u );
      		    shared_ptr<CF> cpp_flux_u =
      		      py::extract<shared_ptr<CF>> (flux_u)();
-		    cpp_flux_u = Compile(cpp_flux_u, compile, 0);
+		    auto raw_flux_u = cpp_flux_u;
+		    if (!native)
+		      cpp_flux_u = NativeCompile(cpp_flux_u, compile);
 
 		    //  CF for numerical flux
 		    py::object numflux_u = NumFlux( u, uother );
 		    shared_ptr<CF> cpp_numflux_u =
 		      py::extract<shared_ptr<CF>> (numflux_u)();
-		    cpp_numflux_u = Compile(cpp_numflux_u, compile, 0);
+		    auto raw_numflux_u = cpp_numflux_u;
+		    if (!native)
+		      cpp_numflux_u = NativeCompile(cpp_numflux_u, compile);
 
 		    // CF for inverse map
 		    py::object invmap = InverseMap( u );
 		    shared_ptr<CF> cpp_invmap =
 		      py::extract<shared_ptr<CF>> (invmap)();
-		    cpp_invmap = Compile(cpp_invmap, compile, 0);
+		    auto raw_invmap = cpp_invmap;
+		    if (!native)
+		      cpp_invmap = NativeCompile(cpp_invmap, compile);
 
 		    // CF for entropy residual
 		    shared_ptr<CF> cpp_entropy = nullptr;
@@ -122,21 +142,21 @@ void ExportConsLaw(py::module & m)
 		      {
 			py::object cf_entropy = Entropy.value()( u );
 			cpp_entropy = py::extract<shared_ptr<CF>> (cf_entropy)();
-			cpp_entropy = Compile(cpp_entropy, compile, 0);
+			cpp_entropy = NativeCompile(cpp_entropy, compile);
 		      }
 		    if(EntropyFlux.has_value())
 		      {
 			py::object cf_entropyflux = EntropyFlux.value()( u );
 			cpp_entropyflux =
 			  py::extract<shared_ptr<CF>> (cf_entropyflux)();
-			cpp_entropyflux = Compile(cpp_entropyflux, compile, 0);
+			cpp_entropyflux = NativeCompile(cpp_entropyflux, compile);
 		      }
 		    if(NumEntropyFlux.has_value())
 		      {
 			py::object cf_numentropyflux = NumEntropyFlux.value()( u, uother);
 			cpp_numentropyflux =
 			  py::extract<shared_ptr<CF>> (cf_numentropyflux)();
-			cpp_numentropyflux = Compile(cpp_numentropyflux, compile, 0);
+			cpp_numentropyflux = NativeCompile(cpp_numentropyflux, compile);
 		      }
 
 		    bool entropy_functions = false;
@@ -152,13 +172,15 @@ void ExportConsLaw(py::module & m)
 						    cpp_flux_u, cpp_numflux_u, cpp_invmap,
 						    cpp_entropy, cpp_entropyflux,
 						    cpp_numentropyflux, compile);
+		    if(native)
+		      cl->SetNativeKernels(raw_flux_u, raw_numflux_u, raw_invmap);
 		    if(ViscosityCoefficient.has_value())
 		      {
 			py::object cf_visccoeff =
 			  ViscosityCoefficient.value()( u, py::cast(cl->proxy_res) );
 			auto cpp_visccoeff =
 			  py::extract<shared_ptr<CF>> (cf_visccoeff)();
-			cpp_visccoeff = Compile(cpp_visccoeff, compile, 0);
+			cpp_visccoeff = NativeCompile(cpp_visccoeff, compile);
 			cl->SetViscosityCoefficient(cpp_visccoeff);
 		      }
 		    else if (entropy_functions)
@@ -178,7 +200,18 @@ void ExportConsLaw(py::module & m)
 	 py::arg("entropy")=nullptr,
 	 py::arg("entropyflux")=nullptr,
          py::arg("numentropyflux")=nullptr,
-	 py::arg("visccoeff")=nullptr
+	 py::arg("visccoeff")=nullptr,
+	 py::arg("native")=false,
+	 "Symbolic conservation law.\n"
+	 "compile=True translates all coefficient functions (fluxes, inverse map,\n"
+	 "entropy, viscosity) into C++ code, which reads the proxies from the\n"
+	 "user data of the trafo.  native=True instead calls kernels for flux,\n"
+	 "numflux and inverse map with the values as arguments, which saves the\n"
+	 "copies into the user data; it replaces compile for these three, compile\n"
+	 "still applies to the other functions.  The compiled libraries are cached\n"
+	 "on disk ($NGSTENTS_CACHE_DIR, default ~/.cache/ngstents) and reused by\n"
+	 "later runs, except for functions containing GridFunctions or Parameters,\n"
+	 "whose addresses in the running process are part of the code."
 	 )
     .def_property_readonly("tentslab", [](shared_ptr<CL> self)
                            {
@@ -217,12 +250,44 @@ void ExportConsLaw(py::module & m)
            SetValues(cf,*(self->gfu),VOL,0,*(self->pylh));
            self->uinit->Set(1.0,*(self->u)); // set data used for b.c.
          })
+    // Ensemble of initial data propagated together with the solution
+    .def("SetEnsemble",
+         [](shared_ptr<CL> self, std::vector<shared_ptr<CF>> cfs)
+         {
+           // members are interpolated through gfu, keep its values
+           Vector<> save(self->u->FVDouble().Size());
+           save = self->u->FVDouble();
+           self->SetEnsembleSize(cfs.size());
+           for (size_t k : Range(cfs.size()))
+             {
+               SetValues(cfs[k],*(self->gfu),VOL,0,*(self->pylh));
+               self->ensemble_u.Row(k) = self->u->FVDouble();
+               self->ensemble_uinit.Row(k) = self->u->FVDouble();
+             }
+           self->u->FVDouble() = save;
+         }, py::arg("initial"),
+         "Set initial data of N ensemble members, which are propagated together with the solution")
+    .def_property_readonly("ensemble", [](shared_ptr<CL> self)
+                           {
+                             auto & mat = self->ensemble_u;
+                             // the capsule owns the memory, not self: after
+                             // SetEnsemble the view shows the old members
+                             auto mem = new shared_ptr<Array<double>>(self->ensemble_mem);
+                             py::capsule owner(mem, [](void * p)
+                               { delete static_cast<shared_ptr<Array<double>>*>(p); });
+                             return py::array_t<double>
+                               ({ mat.Height(), mat.Width() },
+                                { mat.Width()*sizeof(double), sizeof(double) },
+                                mat.Data(), owner);
+                           }, "N x ndof numpy view of the ensemble members. It stays valid,\n"
+                           "but is detached from the conservation law by SetEnsemble.")
     // Set vector field for advection equation
     .def("SetVectorField",
-         [](shared_ptr<CL> self, shared_ptr<CF> cf)
+         [](shared_ptr<CL> self, shared_ptr<CF> cf, bool cache)
          {
-           self->SetVectorField(cf);
-         })
+           self->SetVectorField(cf, cache);
+         }, py::arg("cf"), py::arg("cache")=false,
+         "cache=True evaluates the (time-independent) vector field once at all integration points")
     .def("SetBoundaryCF",[](shared_ptr<CL> self, Region region, shared_ptr<CF> cf)
          {
 	   // bcnr's 0 - 3 used for default boundary conditions
@@ -242,15 +307,80 @@ void ExportConsLaw(py::module & m)
     .def("SetMaterialParameters",
          [](shared_ptr<CL> self,
 	    shared_ptr<CF> cf_mu,
-	    shared_ptr<CF> cf_eps)
+	    shared_ptr<CF> cf_eps,
+            bool cache)
 	 {
-	   self->SetMaterialParameters(cf_mu,cf_eps);
-	 }, py::arg("mu"), py::arg("eps"))
+	   self->SetMaterialParameters(cf_mu,cf_eps,cache);
+	 }, py::arg("mu"), py::arg("eps"), py::arg("cache")=false,
+         "cache=True evaluates the (time-independent) parameters once at all integration points")
     .def("SetTentSolver",
-         [](shared_ptr<CL> self, string method, int stages, int substeps)
+         [](shared_ptr<CL> self, string method, int stages, int substeps,
+            bool adaptive, bool implicit_visc)
          {
            self->SetTentSolver(method, stages, substeps);
-         }, py::arg("method") = "SAT", py::arg("stages") = 2, py::arg("substeps") = 1)
+           self->tentsolver->adaptive = adaptive;
+           self->tentsolver->implicit_visc = implicit_visc;
+         }, py::arg("method") = "SAT", py::arg("stages") = 2, py::arg("substeps") = 1,
+         py::arg("adaptive") = false, py::arg("implicit_visc") = false,
+         "method: \"SAT\", \"SARK\", \"LSSARK\" (low-storage SARK, same coefficients)\n"
+         "or \"IMEX\" (LSSARK with implicit source terms, see SetSource)\n"
+         "adaptive=True: each tent uses substeps scaled by its local wavespeed times\n"
+         "its slope relative to the maximum over the slab (at least 1), see tent_substeps\n"
+         "implicit_visc=True: (LS)SARK with entropy viscosity applies the viscosity by\n"
+         "one implicit Euler step per substep (local preconditioned CG) instead of\n"
+         "explicit steps, whose number grows with the viscosity coefficient")
+    .def("SetSource",
+         [](shared_ptr<CL> self, py::object Source, bool compile)
+         {
+           if (!self->proxy_u)
+             throw Exception("SetSource just available for SymbolicConsLaw");
+           py::object s_u = Source( py::cast(self->proxy_u) );
+           shared_ptr<CF> cpp_source = py::extract<shared_ptr<CF>> (s_u)();
+           auto cpp_dsource = cpp_source->Diff(self->proxy_u.get(), self->proxy_uother);
+           self->SetSource(NativeCompile(cpp_source, compile),
+                           NativeCompile(cpp_dsource, compile));
+         }, py::arg("source"), py::arg("compile") = false,
+         "source: function of u returning the right hand side s(u) of\n"
+         "d_t u + div F(u) = s(u), needs SetTentSolver(\"IMEX\", ...)")
+    .def("SetLimiter",
+         [](shared_ptr<CL> self, bool positivity, bool bounds, bool viscosity)
+         {
+           self->SetLimiter(positivity, bounds, viscosity);
+         }, py::arg("positivity") = true, py::arg("bounds") = false,
+         py::arg("viscosity") = true,
+         "Limit the solution towards the element means after each substep of the\n"
+         "tent solver. positivity=True: keep the states admissible (Euler: positive\n"
+         "density and pressure), bounds=True: keep the values within the range of\n"
+         "the element means of the tent. viscosity=False switches the entropy\n"
+         "viscosity off")
+    .def_property_readonly("tent_substeps", [](shared_ptr<CL> self)
+                           {
+                             return py::array_t<int>(self->tent_substeps.Size(),
+                                                     self->tent_substeps.Data());
+                           }, "number of substeps used in each tent of the last Propagate")
+    .def_property_readonly("visc_iterations", [](shared_ptr<CL> self)
+                           {
+                             return self->tentsolver ?
+                               int(self->tentsolver->max_visc_iterations) : 0;
+                           }, "maximal number of CG iterations of an implicit viscosity solve\n"
+                           "(implicit_visc=True) in the last Propagate")
+    .def("WriteVTU",
+         [](shared_ptr<CL> self, string filename, bool compress, int nparts)
+         {
+           WriteSolutionVTU(self->ma, make_shared<GridFunctionCoefficientFunction>(self->gfu),
+                            "u", self->gftau, self->tps->GetVertexMap(),
+                            filename, nparts, compress);
+         }, py::arg("filename") = "solution", py::arg("compress") = false,
+         py::arg("nparts") = 0,
+         "Binary VTU output of the solution at the top front of the last slab,\n"
+         "evaluated at the element vertices, with the physical time of the front\n"
+         "as point data (see TentSlab.DrawPitchedTentsVTU for the options)")
+    .def("SetIdx3d",
+         [](shared_ptr<CL> self, const SpaceTimeMesh & stmesh)
+         {
+           self->vis3d = make_shared<Visualization3D>(stmesh.idx3d);
+         }, "Set index for visualization on a space-time mesh from\n"
+         "TentSlab.ToSpaceTimeMesh", py::arg("idx3d"))
     .def("SetIdx3d",
          [](shared_ptr<CL> self, py::list lst)
          {
@@ -271,11 +401,186 @@ void ExportConsLaw(py::module & m)
            self->vis3d = make_shared<Visualization3D>(idx3d);
          }, "Set index for visualization on a 3D mesh", py::arg("idx3d"))
     .def("Propagate",
+         [](shared_ptr<CL> self,
+            shared_ptr<GridFunction> hdgf,
+            optional<std::vector<double>> output_times) -> py::object
+         {
+           if (!output_times)
+             {
+               ParallelWorkGuard guard;
+               self->Propagate(*(self->pylh), hdgf);
+               return py::none();
+             }
+           Array<shared_ptr<GridFunction>> gfs;
+           std::exception_ptr error;
+           {
+             // slice_times and slice_gfs belong to a running PropagateAsync
+             // until the guard is taken
+             ParallelWorkGuard guard;
+             for (double t : *output_times)
+               {
+                 auto gf = CreateGridFunction(self->fes, "slice", Flags().SetFlag("novisual"));
+                 gf->Update();
+                 self->slice_times.Append(t);
+                 self->slice_gfs.Append(gf);
+                 gfs.Append(gf);
+               }
+             try { self->Propagate(*(self->pylh), hdgf); }
+             catch (...) { error = std::current_exception(); }
+             self->slice_times.SetSize0();
+             self->slice_gfs.SetSize0();
+           }
+           if (error)
+             std::rethrow_exception(error);
+           py::list ret;
+           for (auto & gf : gfs)
+             ret.append(py::cast(gf));
+           return ret;
+         }, py::arg("hdgf")=nullptr, py::arg("output_times")=nullopt,
+         "Propagate the solution through the slab. hdgf: GridFunction vector for\n"
+         "visualization on the 3D mesh. output_times: physical times t with\n"
+         "time <= t < time + slab height, the solution on these flat time slices\n"
+         "is evaluated in the tents crossing them (linear in time between the\n"
+         "substeps) and projected into new GridFunctions, which are returned")
+    .def("PropagateUntil",
+         [](shared_ptr<CL> self, double tend, py::object callback, int every,
+            shared_ptr<GridFunction> hdgf)
+         {
+           function<bool(int,double)> cb;
+           if (!callback.is_none())
+             cb = [&callback] (int nslabs, double t)
+               {
+                 py::gil_scoped_acquire acquire;
+                 py::object ret = callback(nslabs, t);
+                 return ret.is_none() || ret.cast<bool>();
+               };
+
+           ParallelWorkGuard guard;
+           int nslabs = 0;
+           std::exception_ptr error;
+           // all slabs in one task manager session
+           RunWithTaskManager ([&] ()
+             {
+               try { nslabs = self->PropagateUntil(tend, cb, every, *(self->pylh), hdgf); }
+               catch (...) { error = std::current_exception(); }
+             });
+           if (error)
+             std::rethrow_exception(error);
+           return nslabs;
+         }, py::arg("tend"), py::arg("callback") = py::none(), py::arg("every") = 1,
+         py::arg("hdgf")=nullptr,
+         "Propagate slab by slab until the time tend (up to half a slab), in\n"
+         "C++ and with the task manager running. callback(nslabs, t) is called\n"
+         "after every 'every' slabs, the loop stops if it returns False.\n"
+         "Returns the number of slabs")
+    .def("SetSnapshots",
+         [](shared_ptr<CL> self, optional<string> filename, int every)
+         {
+           py::gil_scoped_release release;
+           // the old writer finishes its file when it is released
+           self->snapshots = nullptr;
+           if (filename)
+             self->snapshots = make_shared<SnapshotWriter>
+               (*filename, self->u->FVDouble().Size(), every);
+         }, py::arg("filename"), py::arg("every") = 1,
+         "Write the solution vector at the end of every 'every' slabs to the\n"
+         "file, in a background thread (see ReadSnapshot, SnapshotTimes).\n"
+         "filename=None finishes and closes the file")
+    .def("FlushSnapshots",
+         [](shared_ptr<CL> self)
+         {
+           if (self->snapshots)
+             self->snapshots->Flush();
+         }, py::call_guard<py::gil_scoped_release>(),
+         "Wait until all snapshots are written")
+    .def("SaveCheckpoint",
+         [](shared_ptr<CL> self, string filename, bool slab)
+         {
+           self->SaveCheckpoint(filename, slab);
+         }, py::arg("filename"), py::arg("slab") = true,
+         py::call_guard<ParallelWorkGuard>(),
+         "Save solution, initial data, front, viscosity and boundary condition\n"
+         "numbers (and the tents of the slab if slab=True) to a checkpoint file.\n"
+         "The data are copied and the file is written in the background, call\n"
+         "WaitCheckpoint to make sure it is complete. Every call copies and\n"
+         "writes the whole state, checkpoints are not updated incrementally")
+    .def("LoadCheckpoint",
+         [](shared_ptr<CL> self, string filename)
+         {
+           self->LoadCheckpoint(filename);
+         }, py::arg("filename"),
+         py::call_guard<ParallelWorkGuard>(),
+         "Restore the state saved by SaveCheckpoint. The conservation law has\n"
+         "to be created on the same mesh and space; if the checkpoint contains\n"
+         "the tents, they replace the tents of the slab without pitching")
+    .def("WaitCheckpoint",
+         [](shared_ptr<CL> self) { self->WaitCheckpoint(); },
+         py::call_guard<py::gil_scoped_release>(),
+         "Wait until the last checkpoint is written")
+    .def("Timing",
+         [](shared_ptr<CL> self, int reps)
+         {
+           Array<std::pair<string,double>> times;
+           {
+             ParallelWorkGuard guard;
+             times = self->Timing(reps, *(self->pylh));
+           }
+           py::dict ret;
+           for (auto & [name, time] : times)
+             ret[py::cast(name)] = time;
+           return ret;
+         }, py::arg("reps") = 1,
+         "Benchmark of the tent kernels on the current slab and solution: dict of\n"
+         "the seconds of one sweep over all tents for each kernel (average of\n"
+         "reps calls per tent), summed over the threads. \"LimitTent\" and\n"
+         "\"Viscosity\" (entropy residual, viscosity coefficient and one explicit\n"
+         "viscosity step) are included if the limiter or the entropy viscosity\n"
+         "is switched on. The solution and the time front are left unchanged")
+    .def("AddProbe",
+         [](shared_ptr<CL> self, std::vector<double> point)
+         {
+           Vector<> p(point.size());
+           for (size_t i : Range(point.size()))
+             p(i) = point[i];
+           return self->AddProbe(p);
+         }, py::arg("point"),
+         "Record the solution at a point in all tents containing it, at the end\n"
+         "of each substep of the tent solver (so the sampling rate grows with\n"
+         "the number of substeps). Returns the number of the probe (see GetProbe)")
+    .def("GetProbe",
+         [](shared_ptr<CL> self, int i)
+         {
+           if (i < 0 || i >= int(self->probe_el.Size()))
+             throw Exception("no probe " + ToString(i));
+           auto & times = self->probe_times[i];
+           auto & values = self->probe_values[i];
+           size_t ncomp = self->u->EntrySize();
+           return py::make_tuple
+             (py::array_t<double>(times.Size(), times.Data()),
+              py::array_t<double>({ times.Size(), ncomp }, values.Data()));
+         }, py::arg("probe"),
+         "Time history of a probe as numpy arrays (times, values) of shapes (n,)\n"
+         "and (n, components), in the order of time")
+    .def("ClearProbes", [](shared_ptr<CL> self) { self->ClearProbes(); },
+         "Forget the samples recorded so far, the probes are kept")
+    .def_property_readonly("time", [](shared_ptr<CL> self) { return self->GetTime(); },
+                           "physical time of the front after the last slab")
+    .def("PropagateAsync",
          [](shared_ptr<CL> self,
             shared_ptr<GridFunction> hdgf)
          {
-            self->Propagate(*(self->pylh), hdgf);
-         }, "GridFunction vector for visualization on 3D mesh"
+           return make_shared<AsyncResult>
+             ([self, hdgf] ()
+              {
+                self->Propagate(*(self->pylh), hdgf);
+                return true;
+              });
+         }, "Propagate in a background thread, returns an AsyncResult. Call it\n"
+         "outside of a TaskManager context: the thread runs without task manager,\n"
+         "so Python may do I/O and NGSolve work meanwhile, but must not enter a\n"
+         "TaskManager context before the result is done. The solution must not be\n"
+         "used before, Propagate and other blocking calls and further async calls\n"
+         "wait for it"
          , py::arg("hdgf")=nullptr)
     ;
 }
@@ -285,4 +590,39 @@ PYBIND11_MODULE(_pyconslaw, m) {
   m.attr("__name__") = "ngstents.conslaw";
   m.attr("__package__") = "ngstents";
   ExportConsLaw(m);
+
+#ifdef NGSTENTS_TESTING
+  m.def("_EulerCompareSIMD", [](shared_ptr<ConservationLaw> cl, int n, unsigned seed)
+        {
+          Vec<3> err = EulerCompareSIMD(cl, n, seed);
+          return py::make_tuple(err(0), err(1), err(2));
+        }, py::arg("cl"), py::arg("n") = 10000, py::arg("seed") = 0,
+        "for testing: largest relative differences of the SIMD and scalar\n"
+        "erf, NumFlux and u_reflect of Euler on n random states");
+#endif
+
+  m.def("SnapshotTimes", [](string filename)
+        {
+          Array<double> times = SnapshotTimes(filename);
+          return py::array_t<double>(times.Size(), times.Data());
+        }, py::arg("filename"), "times of the snapshots in a file");
+  m.def("ReadSnapshot",
+        [](string filename, shared_ptr<GridFunction> gfu, optional<double> time, int index)
+        {
+          if (time)
+            {
+              // the snapshot closest to the given time
+              Array<double> times = SnapshotTimes(filename);
+              if (times.Size() == 0)
+                throw Exception("no snapshots in " + filename);
+              index = 0;
+              for (int k : Range(times))
+                if (abs(times[k] - *time) < abs(times[index] - *time))
+                  index = k;
+            }
+          return ReadSnapshot(filename, index, gfu->GetVector().FVDouble());
+        }, py::arg("filename"), py::arg("gfu"), py::arg("time") = nullopt,
+        py::arg("index") = 0,
+        "Read the snapshot with the given index, or the one closest to time,\n"
+        "into the vector of gfu and return its time");
 }
@@ -1,8 +1,37 @@
 #include "tents.hpp"
+#include "python_async.hpp"
 #include <python_ngstd.hpp>
+#include <pybind11/numpy.h>
 
 typedef CoefficientFunction CF;
 
+std::recursive_mutex & ParallelWorkMutex ()
+{
+  static std::recursive_mutex mutex;
+  return mutex;
+}
+
+static bool PitchTents(shared_ptr<TentPitchedSlab> self,
+                       const double dt, const bool local_ct, const double global_ct)
+{
+  int dim = self->ma->GetDimension();
+  bool success = false;
+  switch(dim){
+  case 1:
+    success = self->PitchTents<1>(dt,local_ct,global_ct);
+    break;
+  case 2:
+    success = self->PitchTents<2>(dt,local_ct,global_ct);
+    break;
+  case 3:
+    success = self->PitchTents<3>(dt,local_ct,global_ct);
+    break;
+  default:
+    throw Exception("TentPitchedSlab not avaiable for dimension "+ToString(dim));
+  }
+  return success;
+}
+
 // python export of tent mesh
 auto ExportTimeSlab(py::module &m)
 {
@@ -41,27 +70,37 @@ auto ExportTimeSlab(py::module &m)
            else
              throw Exception("wrong argument type in SetMaxWavespeed");
          })
-    .def("PitchTents",[](shared_ptr<TentPitchedSlab> self,
-			 const double dt, const bool local_ct, const double global_ct)
+    .def("PitchTents", &PitchTents,
+	 py::arg("dt"), py::arg("local_ct") = false, py::arg("global_ct") = 1.0,
+         py::call_guard<ParallelWorkGuard>())
+    .def("PitchTentsAsync",[](shared_ptr<TentPitchedSlab> self,
+                              const double dt, const bool local_ct, const double global_ct)
 	 {
-	   int dim = self->ma->GetDimension();
-	   bool success = false;
-	   switch(dim){
-	   case 1:
-	     success = self->PitchTents<1>(dt,local_ct,global_ct);
-	     break;
-	   case 2:
-	     success = self->PitchTents<2>(dt,local_ct,global_ct);
-	     break;
-	   case 3:
-	     success = self->PitchTents<3>(dt,local_ct,global_ct);
-	     break;
-	   default:
-	     throw Exception("TentPitchedSlab not avaiable for dimension "+ToString(dim));
-	   }
-	   return success;
+           return make_shared<AsyncResult>
+             ([self, dt, local_ct, global_ct] ()
+              { return PitchTents(self, dt, local_ct, global_ct); });
 	 },
-	 py::arg("dt"), py::arg("local_ct") = false, py::arg("global_ct") = 1.0)
+	 py::arg("dt"), py::arg("local_ct") = false, py::arg("global_ct") = 1.0,
+         "PitchTents in a background thread, returns an AsyncResult whose\n"
+         "result() is the return value of PitchTents. Call it outside of a\n"
+         "TaskManager context and do not enter one before the result is done\n"
+         "(see PropagateAsync)")
+    .def("TimePoleHeight",[](shared_ptr<TentPitchedSlab> self, const bool local_ct,
+                             const double global_ct, int reps)
+	 {
+           switch(self->ma->GetDimension()){
+           case 1: return self->TimePoleHeight<1>(local_ct, global_ct, reps);
+           case 2: return self->TimePoleHeight<2>(local_ct, global_ct, reps);
+           case 3: return self->TimePoleHeight<3>(local_ct, global_ct, reps);
+           default:
+             throw Exception("TentPitchedSlab not avaiable for dimension "
+                             +ToString(self->ma->GetDimension()));
+           }
+	 },
+	 py::arg("local_ct") = false, py::arg("global_ct") = 1.0, py::arg("reps") = 1,
+         py::call_guard<ParallelWorkGuard>(),
+         "Seconds for computing the pole heights of all vertices on a flat front\n"
+         "(average of reps sweeps), for benchmarks")
     .def("GetNTents", &TentPitchedSlab::GetNTents)
     .def("GetNLayers", &TentPitchedSlab::GetNLayers)
     .def("GetSlabHeight", &TentPitchedSlab::GetSlabHeight)
@@ -93,6 +132,25 @@ auto ExportTimeSlab(py::module &m)
 	     self->DrawPitchedTentsVTK(vtkfilename);
 	 },
 	 py::arg("vtkfilename") = "output")
+    .def("DrawPitchedTentsVTU", [](shared_ptr<TentPitchedSlab> self, string filename,
+                                   bool compress, int nparts,
+                                   std::vector<double> active_times)
+	 {
+	   self->DrawPitchedTentsVTU(filename, compress, nparts,
+                                     FlatArray<double>(active_times.size(),
+                                                       active_times.data()));
+	 },
+	 py::arg("filename") = "output", py::arg("compress") = false,
+         py::arg("nparts") = 0, py::arg("active_times") = std::vector<double>(),
+         "Binary VTU output of the tents, written in nparts pieces in parallel\n"
+         "(0: one per thread, collected by filename.pvtu). 1D and 2D tents are\n"
+         "drawn as space-time cells, 3D tents by their spatial elements with the\n"
+         "bottom and top times as point data. active_times: write\n"
+         "filename_active<k> with the tents whose pole contains the time\n"
+         "active_times[k] instead, each with all elements of its patch and the\n"
+         "times as point data. The patches of neighbouring active tents overlap,\n"
+         "the output is not a cut of the slab at the time.\n"
+         "compress=True uses zlib compression.")
     .def("DrawPitchedTentsGL", [](shared_ptr<TentPitchedSlab> self)
   	 {
 	   if(self->ma->GetDimension() == 1)
@@ -113,6 +171,43 @@ auto ExportTimeSlab(py::module &m)
   	     }
   	   return py::make_tuple(data,times,self->GetNTents(),nlevels);
   	 })
+    .def("GetTentData", [](shared_ptr<TentPitchedSlab> self)
+         {
+           // the tents are gathered into tables (one copy per call), the
+           // numpy arrays are views into these tables, owned by a capsule
+           auto tt = new TentTables(self->GetTentTables());
+           py::capsule owner(tt, [](void * p) { delete static_cast<TentTables*>(p); });
+           auto array = [&owner] (auto a)
+             { return py::array(a.Size(), a.Data(), owner); };
+           py::dict d;
+           d["vertex"] = array(FlatArray<int>(tt->vertex));
+           d["level"] = array(FlatArray<int>(tt->level));
+           d["tbot"] = array(FlatArray<double>(tt->tbot));
+           d["ttop"] = array(FlatArray<double>(tt->ttop));
+           d["maxslope"] = array(FlatArray<double>(tt->maxslope));
+           auto table = [&] (string name, auto & tab)
+             {
+               d[(name+"_offsets").c_str()] = array(tab.IndexArray());
+               d[name.c_str()] = array(tab.AsArray());
+             };
+           table("nbv", tt->nbv);
+           d["nbtime"] = array(tt->nbtime.AsArray());
+           table("els", tt->els);
+           table("internal_facets", tt->internal_facets);
+           table("dependent_tents", tt->dependent_tents);
+           return d;
+         },
+         "All tents as numpy arrays: vertex, level, tbot, ttop and maxslope per\n"
+         "tent, and nbv, nbtime, els, internal_facets, dependent_tents in\n"
+         "compressed row storage, e.g. the neighbours of tent i are\n"
+         "nbv[nbv_offsets[i]:nbv_offsets[i+1]] (nbtime has the same offsets).\n"
+         "Each call gathers the tents into new tables, the arrays are views into\n"
+         "them (not into the slab), so call it once and keep the result.")
+    .def("ToSpaceTimeMesh", &TentPitchedSlab::ToSpaceTimeMesh,
+         py::arg("tscale") = 1.0, py::arg("order") = 1,
+         "Space-time mesh of the slab (1D and 2D spatial meshes) with the time\n"
+         "coordinate scaled by tscale, and the maps from the dofs of H1 of the\n"
+         "given order (1 or 2) on the fronts of the slab to the space-time mesh")
     ;
 }
 
@@ -130,6 +225,24 @@ void ExportTents(py::module & m) {
     .def_readonly("internal_facets", &Tent::internal_facets)
     .def("MaxSlope", &Tent::MaxSlope);
 
+  py::class_<SpaceTimeMesh, shared_ptr<SpaceTimeMesh>>
+    (m, "SpaceTimeMesh", "Space-time mesh of a tent pitched slab with the dof maps\n"
+     "of the fronts, smesh[front] is the dict {spatial dof: space-time dof}")
+    .def_readonly("mesh", &SpaceTimeMesh::mesh)
+    .def("__len__", [](const SpaceTimeMesh & self) { return self.idx3d.Size(); })
+    .def("__getitem__", [](const SpaceTimeMesh & self, int front)
+         {
+           if (front < 0 || front >= self.idx3d.Size())
+             throw py::index_error();
+           py::dict d;
+           auto & idx = *self.idx3d[front];
+           for (auto i : Range(idx))
+             for (auto j : idx[i])
+               d[py::cast(i)] = py::cast(j);
+           return d;
+         });
+
+  ExportAsyncResult(m);
   ExportTimeSlab(m);
 }
 
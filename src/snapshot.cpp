@@ -0,0 +1,151 @@
+#include "snapshot.hpp"
+#include <cstring>
+
+static const char snapshot_magic[8] = { 'N','G','S','T','S','N','A','P' };
+static const uint64_t snapshot_version = 1;
+static const size_t snapshot_header = sizeof(snapshot_magic) + 2*sizeof(uint64_t);
+
+
+SnapshotWriter :: SnapshotWriter (const string & filename, size_t asize, int aevery)
+  : out(filename, std::ios::binary), idx(filename + ".idx", std::ios::binary),
+    size(asize), every(max2(aevery, 1))
+{
+  if (!out || !idx)
+    throw Exception("cannot open snapshot file " + filename);
+  uint64_t n = size;
+  out.write(snapshot_magic, sizeof(snapshot_magic));
+  out.write(reinterpret_cast<const char*>(&snapshot_version), sizeof(uint64_t));
+  out.write(reinterpret_cast<const char*>(&n), sizeof(uint64_t));
+  for (auto & b : buffer)
+    b.SetSize(size);
+  writer = std::thread([this] () { Run(); });
+}
+
+SnapshotWriter :: ~SnapshotWriter ()
+{
+  {
+    std::lock_guard<std::mutex> guard(mutex);
+    stop = true;
+  }
+  cv.notify_all();
+  writer.join();
+}
+
+void SnapshotWriter :: Run ()
+{
+  int slot = 0;
+  while (true)
+    {
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [&] { return full[slot] || stop; });
+        if (!full[slot])
+          return;
+      }
+      // the slot is not touched by Slab until it is released below
+      try
+        {
+          out.write(reinterpret_cast<const char*>(&time[slot]), sizeof(double));
+          out.write(reinterpret_cast<const char*>(buffer[slot].Data()),
+                    size*sizeof(double));
+          idx.write(reinterpret_cast<const char*>(&time[slot]), sizeof(double));
+          out.flush();
+          idx.flush();
+          if (!out || !idx)
+            throw Exception("writing the snapshot file failed");
+        }
+      catch (...)
+        {
+          std::lock_guard<std::mutex> guard(mutex);
+          error = std::current_exception();
+        }
+      {
+        std::lock_guard<std::mutex> guard(mutex);
+        full[slot] = false;
+      }
+      cv.notify_all();
+      slot = 1-slot;
+    }
+}
+
+void SnapshotWriter :: CheckError ()
+{
+  std::lock_guard<std::mutex> guard(mutex);
+  if (error)
+    {
+      auto e = error;
+      error = nullptr;
+      std::rethrow_exception(e);
+    }
+}
+
+void SnapshotWriter :: Slab (double t, const BaseVector & u)
+{
+  CheckError();
+  if (++nslabs % every != 0)
+    return;
+  if (u.FVDouble().Size() != size)
+    throw Exception("snapshot: the size of the solution vector has changed");
+
+  // wait for the writer to release the buffer (the one but last snapshot)
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    cv.wait(lock, [&] { return !full[current]; });
+  }
+  buffer[current] = u.FVDouble();
+  {
+    std::lock_guard<std::mutex> guard(mutex);
+    time[current] = t;
+    full[current] = true;
+  }
+  cv.notify_all();
+  current = 1-current;
+  nsnapshots++;
+}
+
+void SnapshotWriter :: Flush ()
+{
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    cv.wait(lock, [&] { return !full[0] && !full[1]; });
+  }
+  CheckError();
+}
+
+
+Array<double> SnapshotTimes (const string & filename)
+{
+  std::ifstream idx(filename + ".idx", std::ios::binary | std::ios::ate);
+  if (!idx)
+    throw Exception("cannot open " + filename + ".idx");
+  Array<double> times(size_t(idx.tellg()) / sizeof(double));
+  idx.seekg(0);
+  idx.read(reinterpret_cast<char*>(times.Data()), times.Size()*sizeof(double));
+  return times;
+}
+
+double ReadSnapshot (const string & filename, size_t k, FlatVector<> u)
+{
+  std::ifstream in(filename, std::ios::binary);
+  if (!in)
+    throw Exception("cannot open snapshot file " + filename);
+  char magic[sizeof(snapshot_magic)];
+  uint64_t version, size;
+  in.read(magic, sizeof(magic));
+  in.read(reinterpret_cast<char*>(&version), sizeof(uint64_t));
+  in.read(reinterpret_cast<char*>(&size), sizeof(uint64_t));
+  if (!in || std::memcmp(magic, snapshot_magic, sizeof(magic)) != 0
+      || version != snapshot_version)
+    throw Exception(filename + " is not a snapshot file");
+  if (size != u.Size())
+    throw Exception("snapshot size " + ToString(size) + " does not match the vector size "
+                    + ToString(u.Size()));
+
+  double t;
+  in.seekg(snapshot_header + k*(1+size)*sizeof(double));
+  in.read(reinterpret_cast<char*>(&t), sizeof(double));
+  in.read(reinterpret_cast<char*>(u.Data()), size*sizeof(double));
+  if (!in)
+    throw Exception("snapshot " + ToString(k) + " not found in " + filename);
+  return t;
+}
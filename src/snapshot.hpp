@@ -0,0 +1,63 @@
+#ifndef SNAPSHOT_HPP
+#define SNAPSHOT_HPP
+
+#include <solve.hpp>
+#include <fstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+using namespace ngsolve;
+
+
+////////////////////////////////////////////////////////////////////////////
+///
+/// Time series of solution vectors, written in a background thread.
+///
+/// At the end of every "every"-th slab the solution is copied into one
+/// of two staging buffers and propagation continues, while the other
+/// buffer is written.  The file consists of a header (magic "NGSTSNAP",
+/// version and vector size as uint64) followed by records of fixed size
+/// (time, vector) in double precision; filename.idx holds the times of
+/// the records for random access by time.
+///
+class SnapshotWriter
+{
+public:
+  SnapshotWriter (const string & filename, size_t asize, int aevery);
+  /// writes the staged snapshots and closes the files
+  ~SnapshotWriter ();
+
+  /// called at the end of each slab, stages u every "every" slabs
+  void Slab (double time, const BaseVector & u);
+  /// waits until the staged snapshots are written
+  void Flush ();
+  size_t NumSnapshots () const { return nsnapshots; }
+
+private:
+  void Run ();
+  void CheckError ();
+
+  std::ofstream out, idx;
+  size_t size;
+  int every;
+  int nslabs = 0;
+  size_t nsnapshots = 0;
+
+  Vector<> buffer[2];
+  double time[2];
+  bool full[2] = { false, false };
+  int current = 0;        ///< buffer for the next snapshot
+  bool stop = false;
+  std::exception_ptr error;
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::thread writer;
+};
+
+/// times of the snapshots in a file
+Array<double> SnapshotTimes (const string & filename);
+
+/// read snapshot k of a file into u, returns its time
+double ReadSnapshot (const string & filename, size_t k, FlatVector<> u);
+
+#endif // SNAPSHOT_HPP
@@ -0,0 +1,393 @@
+// netgen's meshing headers first, they must not see the using directives
+// of tents.hpp
+#include <meshing.hpp>
+#include "tents.hpp"
+
+
+SpaceTimeMesh TentPitchedSlab::ToSpaceTimeMesh (double tscale, int order) const
+{
+  const int sdim = ma->GetDimension();
+  const int dim = sdim + 1;
+  if (!has_been_pitched)
+    throw Exception("ToSpaceTimeMesh: the slab has not been pitched");
+  if (sdim > 2)
+    throw Exception("space-time meshes are only available for 1D and 2D spatial meshes");
+  if (order < 1 || order > 2)
+    throw Exception("ToSpaceTimeMesh: order must be 1 or 2");
+  if (order == 2 && sdim != 2)
+    throw Exception("ToSpaceTimeMesh: order 2 needs a 2D spatial mesh");
+
+  const size_t nv = ma->GetNV();
+  const size_t ne = ma->GetNE(VOL);
+  const size_t nse = ma->GetNE(BND);
+  const int nfronts = nlayers + 2;
+
+  // periodic servants of a master vertex, they are pitched with the master
+  TableCreator<int> create_servants(nv);
+  for ( ; !create_servants.Done(); create_servants++)
+    for (auto v : Range(vmap))
+      if (vmap[v] != v)
+        create_servants.Add(vmap[v], v);
+  Table<int> servants = create_servants.MoveTable();
+
+  // space-time vertices: the spatial vertices at front 0, followed by the
+  // pole tops of the tents (first the tent vertex, then its servants)
+  Array<size_t> first(tents.Size()+1);
+  first[0] = nv;
+  for (size_t i : Range(tents))
+    first[i+1] = first[i] + 1 + servants[tents[i]->vertex].Size();
+  const size_t nstv = first.Last();
+  auto groupvertex = [&] (size_t i, size_t k)
+    {
+      int v = tents[i]->vertex;
+      return k == 0 ? v : servants[v][k-1];
+    };
+
+  // (front, space-time vertex) for each spatial vertex, sorted by front
+  TableCreator<INT<2>> create_fronts(nv);
+  for ( ; !create_fronts.Done(); create_fronts++)
+    {
+      for (size_t v : Range(nv))
+        create_fronts.Add(v, INT<2>(0, v));
+      for (size_t i : Range(tents))
+        for (size_t k : Range(first[i+1]-first[i]))
+          create_fronts.Add(groupvertex(i,k), INT<2>(tents[i]->level+1, first[i]+k));
+    }
+  Table<INT<2>> vfronts = create_fronts.MoveTable();
+  ParallelFor (Range(nv), [&] (size_t v)
+    {
+      QuickSort(vfronts[v], [] (INT<2> a, INT<2> b) { return a[0] < b[0]; });
+    });
+
+  // space-time vertex of v in the latest front before the given one
+  auto below = [&] (int v, int front)
+    {
+      int stv = -1;
+      for (auto fv : vfronts[v])
+        if (fv[0] < front)
+          stv = fv[1];
+      return stv;
+    };
+
+  auto point = [&] (int v, double t)
+    {
+      Vec<3> p = 0.0;
+      if (sdim == 1)
+        p(0) = ma->GetPoint<1>(v)(0);
+      else
+        p.Range(0,2) = ma->GetPoint<2>(v);
+      p(sdim) = tscale * t;
+      return p;
+    };
+
+  Array<Vec<3>> points(nstv);
+  ParallelFor (Range(nv), [&] (size_t v) { points[v] = point(v, 0.0); });
+  ParallelFor (Range(tents), [&] (size_t i)
+    {
+      for (size_t k : Range(first[i+1]-first[i]))
+        points[first[i]+k] = point(groupvertex(i,k), tents[i]->ttop);
+    });
+
+  // elements are oriented as ngsolve's reference elements (positive
+  // Jacobian), boundary elements such that the simplex formed with a
+  // point inside the domain is positive (domain to the left in 2D,
+  // normal pointing inwards in 3D)
+  auto orientation = [dim] (FlatArray<Vec<3>> q)
+    {
+      Vec<3> a = q[1]-q[0], b = q[2]-q[0];
+      if (dim == 2)
+        return a(0)*b(1) - a(1)*b(0);
+      return InnerProduct(Cross(a, b), q[3]-q[0]);
+    };
+  const POINT3D * refverts = ElementTopology::GetVertices(dim == 2 ? ET_TRIG : ET_TET);
+  ArrayMem<Vec<3>,4> refpts(dim+1);
+  for (int j : Range(dim+1))
+    refpts[j] = Vec<3>(refverts[j][0], refverts[j][1], refverts[j][2]);
+  const bool refpositive = orientation(refpts) > 0;
+
+  auto orient = [&] (FlatArray<int> pnums, bool positive)
+    {
+      ArrayMem<Vec<3>,4> q(pnums.Size());
+      for (int j : Range(pnums))
+        q[j] = points[pnums[j]];
+      if ((orientation(q) > 0) != positive)
+        Swap(pnums[0], pnums[1]);
+    };
+
+  // volume elements: the pole top of a tent vertex with the vertices of
+  // each element of the vertex patch at their preceding fronts
+  Array<size_t> elfirst(tents.Size()+1);
+  elfirst[0] = 0;
+  for (size_t i : Range(tents))
+    {
+      size_t cnt = 0;
+      for (size_t k : Range(first[i+1]-first[i]))
+        cnt += ma->GetVertexElements(groupvertex(i,k)).Size();
+      elfirst[i+1] = elfirst[i] + cnt;
+    }
+  Array<int> elpnums((dim+1)*elfirst.Last());
+  ParallelFor (Range(tents), [&] (size_t i)
+    {
+      const int front = tents[i]->level+1;
+      size_t nr = elfirst[i];
+      for (size_t k : Range(first[i+1]-first[i]))
+        for (auto elnr : ma->GetVertexElements(groupvertex(i,k)))
+          {
+            FlatArray<int> pnums = elpnums.Range((dim+1)*nr, (dim+1)*(nr+1));
+            auto vnums = ma->GetElVertices(ElementId(VOL, elnr));
+            pnums[0] = first[i]+k;
+            for (int j : Range(vnums))
+              pnums[j+1] = below(vnums[j], front);
+            orient(pnums, refpositive);
+            nr++;
+          }
+    });
+
+  // boundary elements: the spatial boundaries, base (front 0) and final
+  // (top front) of the slab
+  const int nbnd = ma->GetNRegions(BND);
+  const int idx_base = nbnd+1, idx_final = nbnd+2;
+  Array<string> bcnames;
+  for (int r : Range(nbnd))
+    bcnames.Append(ma->GetMaterial(BND, r));
+  bcnames.Append("base");
+  bcnames.Append("final");
+
+  Array<int> bndpnums(2*dim*ne), bndindex(2*ne);
+  ParallelFor (Range(ne), [&] (size_t elnr)
+    {
+      auto vnums = ma->GetElVertices(ElementId(VOL, elnr));
+      FlatArray<int> base = bndpnums.Range(2*dim*elnr, (2*elnr+1)*dim);
+      FlatArray<int> top = bndpnums.Range((2*elnr+1)*dim, (2*elnr+2)*dim);
+      for (int j : Range(vnums))
+        {
+          base[j] = vnums[j];
+          top[j] = vfronts[vnums[j]].Last()[1];
+        }
+      // inside is above the base and below the final front
+      ArrayMem<Vec<3>,4> q(dim+1);
+      for (int j : Range(dim))
+        q[j] = points[base[j]];
+      q[dim] = q[0];
+      q[dim](sdim) += 1;
+      if (orientation(q) < 0) Swap(base[0], base[1]);
+      for (int j : Range(dim))
+        q[j] = points[top[j]];
+      q[dim] = q[0];
+      q[dim](sdim) -= 1;
+      if (orientation(q) < 0) Swap(top[0], top[1]);
+      bndindex[2*elnr] = idx_base;
+      bndindex[2*elnr+1] = idx_final;
+    });
+
+  // lateral boundary: the tent faces above the spatial boundary elements
+  TableCreator<int> create_v2se(nv);
+  for ( ; !create_v2se.Done(); create_v2se++)
+    for (size_t selnr : Range(nse))
+      for (auto v : ma->GetElVertices(ElementId(BND, selnr)))
+        create_v2se.Add(v, selnr);
+  Table<int> v2se = create_v2se.MoveTable();
+
+  for (size_t i : Range(tents))
+    {
+      const int front = tents[i]->level+1;
+      for (size_t k : Range(first[i+1]-first[i]))
+        {
+          int v = groupvertex(i,k);
+          for (int selnr : v2se[v])
+            {
+              ElementId sei(BND, selnr);
+              auto svnums = ma->GetElVertices(sei);
+              ArrayMem<int,3> pnums(dim);
+              pnums[0] = first[i]+k;
+              for (int j : Range(svnums))
+                pnums[j+1] = below(svnums[j], front);
+
+              // inside is towards the volume element at the boundary element
+              Vec<3> inside = 0.0;
+              for (auto elnr : ma->GetVertexElements(v))
+                {
+                  auto vnums = ma->GetElVertices(ElementId(VOL, elnr));
+                  int found = 0;
+                  for (auto sv : svnums)
+                    for (auto w : vnums)
+                      if (w == sv) found++;
+                  if (found < svnums.Size()) continue;
+                  for (auto w : vnums)
+                    inside += (1.0/vnums.Size()) * point(w, 0.0);
+                  for (auto w : svnums)
+                    inside -= (1.0/svnums.Size()) * point(w, 0.0);
+                  break;
+                }
+              ArrayMem<Vec<3>,4> q(dim+1);
+              for (int j : Range(dim))
+                q[j] = points[pnums[j]];
+              q[dim] = q[0] + inside;
+              if (orientation(q) < 0) Swap(pnums[0], pnums[1]);
+
+              for (auto p : pnums)
+                bndpnums.Append(p);
+              bndindex.Append(ma->GetElIndex(sei)+1);
+            }
+        }
+    }
+
+  // the netgen mesh
+  auto ngmesh = make_shared<netgen::Mesh>();
+  ngmesh->SetDimension(dim);
+  auto pi = [] (int v) { return netgen::PointIndex(v + netgen::PointIndex::BASE); };
+  for (auto & p : points)
+    ngmesh->AddPoint(netgen::Point3d(p(0), p(1), p(2)));
+
+  if (dim == 3)
+    {
+      ngmesh->SetMaterial(1, "mat");
+      for (int r : Range(bcnames))
+        {
+          netgen::FaceDescriptor fd(r+1, 1, 0, 0);
+          fd.SetBCProperty(r+1);
+          ngmesh->AddFaceDescriptor(fd);
+          ngmesh->SetBCName(r, bcnames[r]);
+        }
+      for (size_t nr : Range(elfirst.Last()))
+        {
+          netgen::Element el(netgen::TET);
+          el.SetIndex(1);
+          for (int j : Range(4))
+            el[j] = pi(elpnums[4*nr+j]);
+          ngmesh->AddVolumeElement(el);
+        }
+      for (size_t nr : Range(bndindex))
+        {
+          netgen::Element2d el(netgen::TRIG);
+          el.SetIndex(bndindex[nr]);
+          for (int j : Range(3))
+            el[j] = pi(bndpnums[3*nr+j]);
+          ngmesh->AddSurfaceElement(el);
+        }
+    }
+  else
+    {
+      ngmesh->AddFaceDescriptor(netgen::FaceDescriptor(1, 1, 0, 0));
+      ngmesh->SetMaterial(1, "mat");
+      for (size_t nr : Range(elfirst.Last()))
+        {
+          netgen::Element2d el(netgen::TRIG);
+          el.SetIndex(1);
+          for (int j : Range(3))
+            el[j] = pi(elpnums[3*nr+j]);
+          ngmesh->AddSurfaceElement(el);
+        }
+      for (size_t nr : Range(bndindex))
+        {
+          netgen::Segment seg;
+          seg[0] = pi(bndpnums[2*nr]);
+          seg[1] = pi(bndpnums[2*nr+1]);
+          seg.si = bndindex[nr];
+          seg.edgenr = bndindex[nr];
+          seg.epgeominfo[0].edgenr = bndindex[nr];
+          seg.epgeominfo[1].edgenr = bndindex[nr];
+          ngmesh->AddSegment(seg);
+        }
+      for (int r : Range(bcnames))
+        ngmesh->SetBCName(r, bcnames[r]);
+    }
+
+  // periodic identifications of the space-time vertices on the same front
+  for (int idnr : Range(ma->GetNPeriodicIdentifications()))
+    {
+      for (const auto & pair : ma->GetPeriodicNodes(NT_VERTEX, idnr))
+        for (auto fm : vfronts[pair[0]])
+          for (auto fs : vfronts[pair[1]])
+            if (fm[0] == fs[0])
+              ngmesh->GetIdentifications().Add(pi(fm[1]), pi(fs[1]), idnr+1);
+      ngmesh->GetIdentifications().SetType(idnr+1, netgen::Identifications::PERIODIC);
+    }
+
+  SpaceTimeMesh stmesh;
+  stmesh.mesh = make_shared<MeshAccess>(ngmesh);
+
+  // dof maps of the H1 spaces of the given order: vertex dofs, followed
+  // by the edge dofs of the edges used by elements
+  Array<int> edgedof(ma->GetNEdges());
+  edgedof = -1;
+  size_t ndof = nv;
+  Table<int> v2edges;
+  ClosedHashTable<INT<2>,int> stedges(order == 2 ? 2*stmesh.mesh->GetNEdges()+1 : 1);
+  if (order == 2)
+    {
+      BitArray used(ma->GetNEdges());
+      used.Clear();
+      for (size_t elnr : Range(ne))
+        for (auto e : ma->GetElEdges(ElementId(VOL, elnr)))
+          used.SetBit(e);
+      for (int e : Range(edgedof))
+        if (used.Test(e))
+          edgedof[e] = ndof++;
+
+      TableCreator<int> create_v2edges(nv);
+      for ( ; !create_v2edges.Done(); create_v2edges++)
+        for (int e : Range(edgedof))
+          if (edgedof[e] >= 0)
+            {
+              auto pnums = ma->GetEdgePNums(e);
+              create_v2edges.Add(pnums[0], e);
+              create_v2edges.Add(pnums[1], e);
+            }
+      v2edges = create_v2edges.MoveTable();
+
+      for (int e : Range(stmesh.mesh->GetNEdges()))
+        {
+          auto pnums = stmesh.mesh->GetEdgePNums(e);
+          stedges.Set(INT<2>(pnums[0], pnums[1]).Sort(), e);
+        }
+    }
+  auto stedgedof = [&] (int stv1, int stv2)
+    {
+      return int(nstv) + stedges.Get(INT<2>(stv1, stv2).Sort());
+    };
+
+  TableCreator<int> create_fronttents(nfronts);
+  for ( ; !create_fronttents.Done(); create_fronttents++)
+    for (size_t i : Range(tents))
+      create_fronttents.Add(tents[i]->level+1, i);
+  Table<int> fronttents = create_fronttents.MoveTable();
+
+  stmesh.idx3d.SetSize(nfronts);
+  ParallelFor (Range(nfronts), [&] (size_t front)
+    {
+      TableCreator<int> create_idx(ndof);
+      for ( ; !create_idx.Done(); create_idx++)
+        {
+          if (front == 0)
+            {
+              for (size_t v : Range(nv))
+                create_idx.Add(v, v);
+              for (int e : Range(edgedof))
+                if (edgedof[e] >= 0)
+                  {
+                    auto pnums = ma->GetEdgePNums(e);
+                    create_idx.Add(edgedof[e], stedgedof(pnums[0], pnums[1]));
+                  }
+              continue;
+            }
+          for (int i : fronttents[front])
+            for (size_t k : Range(first[i+1]-first[i]))
+              {
+                int v = groupvertex(i,k);
+                int stv = first[i]+k;
+                create_idx.Add(v, stv);
+                if (order == 2)
+                  for (int e : v2edges[v])
+                    {
+                      auto pnums = ma->GetEdgePNums(e);
+                      int w = pnums[0] == v ? pnums[1] : pnums[0];
+                      create_idx.Add(edgedof[e], stedgedof(stv, below(w, front)));
+                    }
+              }
+        }
+      stmesh.idx3d[front] = make_shared<Table<int>>(create_idx.MoveTable());
+    });
+
+  return stmesh;
+}
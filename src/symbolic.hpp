@@ -0,0 +1,275 @@
+#ifndef SYMBOLIC_HPP
+#define SYMBOLIC_HPP
+
+#include <solve.hpp>
+using namespace ngsolve;
+
+#include "tconservationlaw_tp_impl.hpp"
+#include "nativecode.hpp"
+
+typedef CoefficientFunction CF;
+
+template <int D, int COMP, int ECOMP>
+class SymbolicConsLaw : public T_ConservationLaw<SymbolicConsLaw<D,COMP,ECOMP>, D, COMP, ECOMP, true>
+{
+  typedef T_ConservationLaw<SymbolicConsLaw<D, COMP, ECOMP>, D, COMP, ECOMP, true> BASE;
+
+  shared_ptr<CF> cf_flux = nullptr;
+  shared_ptr<CF> cf_numflux = nullptr;
+  shared_ptr<CF> cf_invmap = nullptr;
+  // cf's for entropy residual
+  shared_ptr<CF> cf_entropy = nullptr;
+  shared_ptr<CF> cf_entropyflux = nullptr;
+  shared_ptr<CF> cf_numentropyflux = nullptr;
+  shared_ptr<CF> cf_visccoeff = nullptr;
+  // source and its derivative in direction proxy_uother
+  shared_ptr<CF> cf_source = nullptr;
+  shared_ptr<CF> cf_dsource = nullptr;
+
+  // compiled differentials
+  shared_ptr<CF> ddu_invmap = nullptr;
+  shared_ptr<CF> ddphi_invmap = nullptr;
+  shared_ptr<CF> ddu_entropy = nullptr;
+
+  // natively compiled flux, numerical flux and inverse map (optional)
+  unique_ptr<NativeKernel> native_flux = nullptr;
+  unique_ptr<NativeKernel> native_numflux = nullptr;
+  unique_ptr<NativeKernel> native_invmap = nullptr;
+
+  using BASE::proxy_u;
+  using BASE::proxy_uother;
+  using BASE::proxy_graddelta;
+  using BASE::proxy_res;
+  using BASE::tps;
+public:
+  SymbolicConsLaw (const shared_ptr<GridFunction> & agfu,
+		   const shared_ptr<TentPitchedSlab> & atps,
+		   const shared_ptr<ProxyFunction> & aproxy_u,
+		   const shared_ptr<ProxyFunction> & aproxy_uother,
+		   const shared_ptr<CF> & acf_flux,
+		   const shared_ptr<CF> & acf_numflux,
+		   const shared_ptr<CF> & acf_invmap,
+		   const shared_ptr<CF> & acf_entropy,
+		   const shared_ptr<CF> & acf_entropyflux,
+		   const shared_ptr<CF> & acf_numentropyflux,
+		   const bool compile)
+    : BASE (agfu, atps, "symbolic"),
+      cf_flux{acf_flux}, cf_numflux{acf_numflux}, cf_invmap{acf_invmap},
+      cf_entropy{acf_entropy}, cf_entropyflux{acf_entropyflux},
+      cf_numentropyflux{acf_numentropyflux}
+  {
+    // set proxies
+    proxy_u = aproxy_u;
+    proxy_uother = aproxy_uother;
+
+    if(cf_entropy)
+      {
+	// precompute derivatives for entropy residual
+	ddu_invmap = cf_invmap->Diff(proxy_u.get(), proxy_uother);
+	ddu_invmap = NativeCompile(ddu_invmap, compile);
+
+	ddphi_invmap = cf_invmap->Diff(BASE::tps->cfgradphi.get(), proxy_graddelta);
+	ddphi_invmap = NativeCompile(ddphi_invmap, compile);
+
+	auto temp = cf_entropy - cf_entropyflux*tps->cfgradphi;
+	ddu_entropy = temp->Diff(proxy_u.get(), proxy_uother);
+	ddu_entropy = NativeCompile(ddu_entropy, compile);
+      }
+  }
+
+  using BASE::Flux;
+  using BASE::NumFlux;
+  using BASE::InverseMap;
+
+  // set values of a proxy, unless the kernel evaluated them in place
+  static void SetProxyValues (FlatMatrix<SIMD<double>> mem,
+                              FlatMatrix<SIMD<double>> values)
+  {
+    if (mem.Data() != values.Data())
+      mem = values;
+  }
+
+  // solve for û: Û = ĝ(x̂, t̂, û) - ∇̂ φ(x̂, t̂) ⋅ f̂(x̂, t̂, û)
+  // at all points in an integration rule
+  void InverseMap(const SIMD_BaseMappedIntegrationRule & mir,
+		  FlatMatrix<SIMD<double>> gradphi, FlatMatrix<SIMD<double>> u) const
+  {
+    if (native_invmap)
+      {
+        // result overwrites u column by column after it has been read
+        FlatMatrix<SIMD<double>> args[] = { u, gradphi };
+        (*native_invmap)(mir, args, u);
+        return;
+      }
+    ProxyUserData & ud = *static_cast<ProxyUserData*>(mir.GetTransformation().userdata);
+    ud.GetAMemory(proxy_u.get()) = u;                  // set values for u
+    ud.GetAMemory(BASE::tps->cfgradphi.get()) = gradphi;  // set values for grad(phi)
+    cf_invmap->Evaluate(mir, u);
+  }
+
+  void InverseMap(const SIMD_BaseMappedIntegrationRule & mir,
+		  FlatMatrix<SIMD<double>> gradphi,
+		  FlatMatrix<SIMD<double>> graddelta,
+		  FlatMatrix<SIMD<double>> u,
+		  FlatMatrix<SIMD<double>> ut) const
+  {
+    ProxyUserData & ud = *static_cast<ProxyUserData*>(mir.GetTransformation().userdata);
+    ud.GetAMemory(proxy_u.get()) = u;                  // set values for u
+    ud.GetAMemory(proxy_uother.get()) = ut;            // abuse other proxy for derivatives
+    ud.GetAMemory(BASE::tps->cfgradphi.get()) = gradphi;  // set values for grad(phi)
+    ud.GetAMemory(proxy_graddelta.get()) = graddelta;     // set values for graddelta
+
+    STACK_ARRAY(SIMD<double>, mem, COMP*mir.Size());
+    FlatMatrix<SIMD<double>> temp(COMP, mir.Size(), mem);
+
+    // map derivative
+    ddu_invmap->Evaluate(mir, ut);
+    ddphi_invmap->Evaluate(mir, temp);
+    ut += temp;
+    // map function value
+    cf_invmap->Evaluate(mir, u);
+  }
+
+  // flux f(u)
+  void Flux (const SIMD_BaseMappedIntegrationRule & mir,
+             FlatMatrix<SIMD<double>> u, FlatMatrix<SIMD<double>> flux) const
+  {
+    if (native_flux)
+      {
+        FlatMatrix<SIMD<double>> args[] = { u };
+        (*native_flux)(mir, args, flux);
+        return;
+      }
+    ProxyUserData & ud = *static_cast<ProxyUserData*>(mir.GetTransformation().userdata);
+    SetProxyValues(ud.GetAMemory(proxy_u.get()), u); // set values for u
+    cf_flux->Evaluate(mir, flux);
+  }
+
+  // numerical flux
+  void NumFlux(const SIMD_BaseMappedIntegrationRule & mir,
+	       FlatMatrix<SIMD<double>> ul, FlatMatrix<SIMD<double>> ur,
+	       FlatMatrix<SIMD<double>> normals, FlatMatrix<SIMD<double>> fna) const
+  {
+    if (native_numflux)
+      {
+        FlatMatrix<SIMD<double>> args[] = { ul, ur };
+        (*native_numflux)(mir, args, fna);
+        return;
+      }
+    ProxyUserData & ud = *static_cast<ProxyUserData*>(mir.GetTransformation().userdata);
+    SetProxyValues(ud.GetAMemory(proxy_u.get()), ul); // set values for ul
+    SetProxyValues(ud.GetAMemory(proxy_uother.get()), ur); // set values for ur
+    cf_numflux->Evaluate(mir,fna);
+  }
+
+  // calc \d\hat{t}(\hat{E}) for \hat{E} = E(u) - F(u)*grad(phi) and F(u)
+  void CalcEntropy (const SIMD_BaseMappedIntegrationRule & mir,
+		    FlatMatrix<SIMD<double>> u, FlatMatrix<SIMD<double>> ut,
+		    FlatMatrix<SIMD<double>> gradphi, FlatMatrix<SIMD<double>> graddelta,
+		    FlatMatrix<SIMD<double>> dEdt, FlatMatrix<SIMD<double>> F) const
+  {
+    ProxyUserData & ud = *static_cast<ProxyUserData*>(mir.GetTransformation().userdata);
+    ud.GetAMemory(proxy_u.get()) = u;                  // set values for u
+    ud.GetAMemory(proxy_uother.get()) = ut;            // abuse other proxy for derivatives
+    ud.GetAMemory(BASE::tps->cfgradphi.get()) = gradphi;   // set values for grad(phi)
+    ud.GetAMemory(proxy_graddelta.get()) = graddelta;      // set values for graddelta
+
+    ddu_entropy->Evaluate(mir, dEdt);
+    cf_entropyflux->Evaluate(mir, F);
+    // add linear part to derivative
+    for( size_t i : Range(dEdt.Width()))
+      dEdt(0,i) -= InnerProduct(F.Col(i), graddelta.Col(i));
+  }
+
+  // numerical entropy flux
+  void NumEntropyFlux(const SIMD_BaseMappedIntegrationRule & mir,
+		      FlatMatrix<SIMD<double>> ul, FlatMatrix<SIMD<double>> ur,
+		      FlatMatrix<SIMD<double>> normals, FlatMatrix<SIMD<double>> fna) const
+  {
+    ProxyUserData & ud = *static_cast<ProxyUserData*>(mir.GetTransformation().userdata);
+    ud.GetAMemory(proxy_u.get()) = ul;      // set values for ul
+    ud.GetAMemory(proxy_uother.get()) = ur; // set values for ur
+    cf_numentropyflux->Evaluate(mir,fna);
+  }
+
+  void SetViscosityCoefficient(shared_ptr<CoefficientFunction> cf_visc)
+  {
+    cf_visccoeff = cf_visc;
+  }
+
+  void SetNumEntropyFlux(shared_ptr<CoefficientFunction> cf_numentropyflux)
+  {
+    BASE::cf_numentropyflux = cf_numentropyflux;
+  }
+
+  void SetNativeKernels(shared_ptr<CoefficientFunction> acf_flux,
+                        shared_ptr<CoefficientFunction> acf_numflux,
+                        shared_ptr<CoefficientFunction> acf_invmap)
+  {
+    // order of the inputs = order of the kernel arguments
+    CoefficientFunction * inputs_u[] = { proxy_u.get() };
+    CoefficientFunction * inputs_numflux[] = { proxy_u.get(), proxy_uother.get() };
+    CoefficientFunction * inputs_invmap[] = { proxy_u.get(), tps->cfgradphi.get() };
+    native_flux = make_unique<NativeKernel>(acf_flux, FlatArray<CoefficientFunction*>(1, inputs_u));
+    native_numflux = make_unique<NativeKernel>(acf_numflux, FlatArray<CoefficientFunction*>(2, inputs_numflux));
+    native_invmap = make_unique<NativeKernel>(acf_invmap, FlatArray<CoefficientFunction*>(2, inputs_invmap));
+  }
+
+  void SetSource(shared_ptr<CoefficientFunction> acf_source,
+                 shared_ptr<CoefficientFunction> acf_dsource)
+  {
+    cf_source = acf_source;
+    cf_dsource = acf_dsource;
+    BASE::has_source = true;
+  }
+
+  // source s(u)
+  void Source (const SIMD_BaseMappedIntegrationRule & mir,
+               FlatMatrix<SIMD<double>> u, FlatMatrix<SIMD<double>> s) const
+  {
+    ProxyUserData & ud = *static_cast<ProxyUserData*>(mir.GetTransformation().userdata);
+    SetProxyValues(ud.GetAMemory(proxy_u.get()), u); // set values for u
+    cf_source->Evaluate(mir, s);
+  }
+
+  // Jacobian of the source, column by column as derivative in the
+  // directions of the unit vectors (abuse other proxy for the direction)
+  void SourceJacobian (const SIMD_BaseMappedIntegrationRule & mir,
+                       FlatMatrix<SIMD<double>> u,
+                       FlatMatrix<SIMD<double>> ds) const
+  {
+    ProxyUserData & ud = *static_cast<ProxyUserData*>(mir.GetTransformation().userdata);
+    SetProxyValues(ud.GetAMemory(proxy_u.get()), u); // set values for u
+    auto dir = ud.GetAMemory(proxy_uother.get());
+
+    STACK_ARRAY(SIMD<double>, mem, COMP*mir.Size());
+    FlatMatrix<SIMD<double>> dsj(COMP, mir.Size(), mem);
+    for (size_t j : Range(COMP))
+      {
+        dir = 0.0;
+        dir.Row(j) = 1.0;
+        cf_dsource->Evaluate(mir, dsj);
+        for (size_t i : Range(COMP))
+          ds.Row(COMP*i+j) = dsj.Row(i);
+      }
+  }
+
+  // compute the viscosity coefficient
+  void CalcViscCoeffEl(const SIMD_BaseMappedIntegrationRule & mir,
+                       FlatMatrix<SIMD<double>> u,
+                       FlatMatrix<SIMD<double>> res,
+                       const double hi, double & coeff) const
+  {
+    ProxyUserData & ud = *static_cast<ProxyUserData*>(mir.GetTransformation().userdata);
+    ud.GetAMemory(proxy_u.get()) = u; // set values for u
+    ud.GetAMemory(proxy_res.get()) = res;
+    cf_visccoeff->Evaluate(mir,res);
+    coeff = 0.0;
+    for(size_t i : Range(res.Width()))
+      for(size_t j : Range(SIMD<double>::Size()))
+	if(res(0,i)[j] > coeff)
+	  coeff = res(0,i)[j];
+  }
+};
+
+#endif // SYMBOLIC_HPP
@@ -5,6 +5,50 @@
 #include "paralleldepend.hpp"
 #include "tentsolver_impl.hpp"
 
+template <typename EQUATION, int DIM, int COMP, int ECOMP, bool SYMBOLIC>
+void T_ConservationLaw<EQUATION, DIM, COMP, ECOMP, SYMBOLIC>::
+InitUserData (const Tent & tent, LocalHeap & lh) const
+{
+  if constexpr(SYMBOLIC)
+    {
+      auto fedata = tent.fedata;
+      if (!fedata) throw Exception("fedata not set");
+
+      auto make_ud = [&] (size_t nip)
+        {
+          ProxyUserData * ud = new (lh) ProxyUserData(2, 1, lh);
+          ud->AssignMemory (proxy_u.get(), nip, COMP, lh);
+          ud->AssignMemory (proxy_uother.get(), nip, COMP, lh);
+          ud->AssignMemory (tps->cfgradphi.get(), nip, DIM, lh);
+          return ud;
+        };
+      fedata->ud_el = make_ud (fedata->iri[0]->GetNIP());
+      if (tent.internal_facets.Size())
+        fedata->ud_facet = make_ud (fedata->firi[0][0]->GetNIP());
+    }
+}
+
+template <typename EQUATION, int DIM, int COMP, int ECOMP, bool SYMBOLIC>
+ProxyUserData & T_ConservationLaw<EQUATION, DIM, COMP, ECOMP, SYMBOLIC>::
+GetUserData (const Tent & tent, int elnr, bool facet,
+             const SIMD_IntegrationRule & ir, LocalHeap & lh) const
+{
+  auto fedata = tent.fedata;
+  ProxyUserData * ud = facet ? fedata->ud_facet : fedata->ud_el;
+  // rules of a different size (mixed element types) get their own memory
+  if (!ud || ud->GetAMemory(proxy_u.get()).Width() != ir.Size())
+    {
+      ud = new (lh) ProxyUserData(2, 1, lh);
+      ud->AssignMemory (proxy_u.get(), ir.GetNIP(), COMP, lh);
+      ud->AssignMemory (proxy_uother.get(), ir.GetNIP(), COMP, lh);
+      ud->AssignMemory (tps->cfgradphi.get(), ir.GetNIP(), DIM, lh);
+    }
+  auto & trafo = *fedata->trafoi[elnr];
+  const_cast<ElementTransformation&>(trafo).userdata = ud;
+  ud->fel = fedata->fei[elnr];
+  return *ud;
+}
+
 template <typename EQUATION, int DIM, int COMP, int ECOMP, bool SYMBOLIC>
 void T_ConservationLaw<EQUATION, DIM, COMP, ECOMP, SYMBOLIC>::
 CalcFluxTent(const Tent & tent, const FlatMatrixFixWidth<COMP> u,
@@ -31,17 +75,11 @@ CalcFluxTent(const Tent & tent, const FlatMatrixFixWidth<COMP> u,
       IntRange dn = fedata->ranges[i];
 
       FlatMatrix<SIMD<double>> flux_iptsa(DIM*COMP, simd_ir.Size(),lh);
-      FlatMatrix<SIMD<double>> flux_iptsa2(DIM*COMP, simd_ir.Size(),lh);
-      FlatMatrix<SIMD<double>> u_iptsa(COMP, simd_ir.Size(),lh);
+      // symbolic: evaluate u directly into the proxy memory
+      FlatMatrix<SIMD<double>> u_iptsa = SYMBOLIC
+	? GetUserData(tent, i, false, simd_ir, lh).GetAMemory(proxy_u.get())
+	: FlatMatrix<SIMD<double>>(COMP, simd_ir.Size(), lh);
 
-      if constexpr(SYMBOLIC)
-      	{
-	  ProxyUserData * ud = new (lh) ProxyUserData(1, lh);
-	  auto & trafo = *fedata->trafoi[i];
-	  const_cast<ElementTransformation&>(trafo).userdata = ud;
-	  ud->fel = &fel;
-	  ud->AssignMemory (proxy_u.get(), simd_ir.GetNIP(), COMP, lh);
-      	}
       fel.Evaluate (simd_ir, u.Rows(dn), u_iptsa);
       Cast().Flux(simd_mir, u_iptsa, flux_iptsa);
 
@@ -71,20 +109,21 @@ CalcFluxTent(const Tent & tent, const FlatMatrixFixWidth<COMP> u,
           auto & simd_ir_facet_vol2 = *fedata->firi[i][1];
 
           int simd_nipt = simd_ir_facet_vol1.Size(); // IR's have the same size
-          FlatMatrix<SIMD<double>> u1(COMP, simd_nipt, lh),
-                                   u2(COMP, simd_nipt, lh);
-
-          auto & simd_mir1 = *fedata->mfiri1[i];
+          FlatMatrix<SIMD<double>> u1, u2;
 	  if constexpr(SYMBOLIC)
 	    {
-	      ProxyUserData * ud = new (lh) ProxyUserData(2, lh);
-	      auto & trafo1 = *fedata->trafoi[elnr1];
-	      const_cast<ElementTransformation&>(trafo1).userdata = ud;
-	      ud->fel = &fel1;
-	      // assume IR's have the same size
-	      ud->AssignMemory (proxy_u.get(), simd_ir_facet_vol1.GetNIP(), COMP, lh);
-	      ud->AssignMemory (proxy_uother.get(), simd_ir_facet_vol1.GetNIP(), COMP, lh);
+	      // evaluate u1, u2 directly into the proxy memory
+	      auto & ud = GetUserData(tent, elnr1, true, simd_ir_facet_vol1, lh);
+	      u1.AssignMemory(COMP, simd_nipt, ud.GetAMemory(proxy_u.get()).Data());
+	      u2.AssignMemory(COMP, simd_nipt, ud.GetAMemory(proxy_uother.get()).Data());
 	    }
+	  else
+	    {
+	      u1.AssignMemory(COMP, simd_nipt, lh);
+	      u2.AssignMemory(COMP, simd_nipt, lh);
+	    }
+
+          auto & simd_mir1 = *fedata->mfiri1[i];
 	  fel1.Evaluate(simd_ir_facet_vol1, u.Rows(dn1), u1);
 	  fel2.Evaluate(simd_ir_facet_vol2, u.Rows(dn2), u2);
 
@@ -109,31 +148,21 @@ CalcFluxTent(const Tent & tent, const FlatMatrixFixWidth<COMP> u,
           auto & simd_ir_facet_vol1 = *fedata->firi[i][0];
 
           int simd_nipt = simd_ir_facet_vol1.Size(); // IR's have the same size
-          FlatMatrix<SIMD<double>> u1(COMP, simd_nipt, lh),
-                                   u2(COMP, simd_nipt, lh);
-
-	  ArrayMem<int,2> elnums;
-	  ArrayMem<int,8> selvnums;
-	  ma->GetFacetSurfaceElements (tent.internal_facets[i], elnums);
+          FlatMatrix<SIMD<double>> u1, u2(COMP, simd_nipt, lh);
 
-	  ElementId sei(BND, elnums[0]);
-	  ElementTransformation & strafo = ma->GetTrafo (sei, lh);
-	  selvnums = ma->GetElVertices (sei);
-	  Facet2SurfaceElementTrafo stransform(strafo.GetElementType(), selvnums);
-	  auto & ir_facet_surf = stransform(*fedata->fir[i], lh);
-	  auto & smir = strafo(ir_facet_surf, lh);
+	  // surface mapping precomputed in TentDataFE
+	  ElementTransformation & strafo = *fedata->strafoi[i];
+	  auto & smir = *fedata->msfiri[i];
 
-	  ProxyUserData * ud = nullptr;
 	  if constexpr(SYMBOLIC)
 	    {
-	      ud = new (lh) ProxyUserData(2, lh);
-	      auto & trafo1 = *fedata->trafoi[elnr1];
-	      const_cast<ElementTransformation&>(trafo1).userdata = ud; // still needed?
-	      ud->fel = &fel1;
-	      ud->AssignMemory (proxy_u.get(), simd_ir_facet_vol1.GetNIP(), COMP, lh);
-	      ud->AssignMemory (proxy_uother.get(), simd_ir_facet_vol1.GetNIP(), COMP, lh);
-	      const_cast<ElementTransformation&>(strafo).userdata = ud;
+	      // evaluate u1 directly into the proxy memory seen by cf_bnd
+	      auto & ud = GetUserData(tent, elnr1, true, simd_ir_facet_vol1, lh);
+	      const_cast<ElementTransformation&>(strafo).userdata = &ud;
+	      u1.AssignMemory(COMP, simd_nipt, ud.GetAMemory(proxy_u.get()).Data());
 	    }
+	  else
+	    u1.AssignMemory(COMP, simd_nipt, lh);
           fel1.Evaluate(simd_ir_facet_vol1,u.Rows(dn1),u1);
           auto & simd_mir = *fedata->mfiri1[i];
 
@@ -160,12 +189,6 @@ CalcFluxTent(const Tent & tent, const FlatMatrixFixWidth<COMP> u,
 	    {
 	      if(cf_bnd.Size())
 	      	{
-		  if constexpr(SYMBOLIC)
-		    {
-		      // set values for u on boundary
-		      ud->GetAMemory(proxy_u.get()) = u1;
-		    }
-		  smir.GetNormals() = simd_mir.GetNormals(); // outward normal
 		  cf_bnd[derive_cf_bnd]->Evaluate(smir,u2);
 
 		  auto index = strafo.GetElementIndex();
@@ -207,7 +230,7 @@ template <typename EQUATION, int DIM, int COMP, int ECOMP, bool SYMBOLIC>
 void T_ConservationLaw<EQUATION, DIM, COMP, ECOMP, SYMBOLIC>::
 CalcViscosityTent (const Tent & tent, FlatMatrixFixWidth<COMP> u,
                    FlatMatrixFixWidth<COMP> ubnd, FlatVector<double> nu,
-                   FlatMatrixFixWidth<COMP> visc, LocalHeap & lh)
+                   FlatMatrixFixWidth<COMP> visc, LocalHeap & lh, bool solvem)
 {
   // const Tent & tent = tps->GetTent(tentnr);
 
@@ -351,10 +374,203 @@ CalcViscosityTent (const Tent & tent, FlatMatrixFixWidth<COMP> u,
         }
     }
 
-  for (int i : Range (tent.els))
+  if (solvem)
+    for (int i : Range (tent.els))
+      {
+        SolveM (tent, i, fedata->adelta[i], visc.Rows (tent.fedata->ranges[i]), lh);
+      }
+}
+
+template <typename EQUATION, int DIM, int COMP, int ECOMP, bool SYMBOLIC>
+bool T_ConservationLaw<EQUATION, DIM, COMP, ECOMP, SYMBOLIC>::
+LimitTent (const Tent & tent, double tstar, FlatMatrixFixWidth<COMP> uhat,
+           FlatMatrixFixWidth<COMP> u, LocalHeap & lh)
+{
+  auto fedata = tent.fedata;
+  if (!fedata) throw Exception("fedata not set");
+
+  HeapReset hr(lh);
+  const size_t nels = tent.els.Size();
+
+  // element means of the coefficients c at the points of the element rules
+  auto calc_mean = [&] (size_t i, FlatMatrixFixWidth<COMP> c,
+                        FlatMatrix<SIMD<double>> pts, FlatVector<> mean)
+    {
+      auto & fel = static_cast<const BaseScalarFiniteElement&> (*fedata->fei[i]);
+      auto & simd_mir = *fedata->miri[i];
+      fel.Evaluate(*fedata->iri[i], c.Rows(fedata->ranges[i]), pts);
+      Vec<COMP,SIMD<double>> sum = SIMD<double>(0.0);
+      SIMD<double> measure = 0.0;
+      for (size_t k : Range(simd_mir.Size()))
+        {
+          sum += simd_mir[k].GetWeight() * pts.Col(k);
+          measure += simd_mir[k].GetWeight();
+        }
+      for (size_t c : Range(COMP))
+        mean(c) = HSum(sum(c)) / HSum(measure);
+    };
+
+  // The means are shifted through the first basis function, which is
+  // the constant 1 for the L2 elements of the tents
+#ifndef NDEBUG
+  for (size_t i : Range(nels))
+    {
+      HeapReset hr(lh);
+      auto & fel = static_cast<const BaseScalarFiniteElement&> (*fedata->fei[i]);
+      const SIMD_IntegrationRule & ir = *fedata->iri[i];
+      FlatVector<> e0(fel.GetNDof(), lh);
+      FlatVector<SIMD<double>> vals(ir.Size(), lh);
+      e0 = 0.0;
+      e0(0) = 1.0;
+      fel.Evaluate(ir, e0, vals);
+      for (size_t k : Range(ir.Size()))
+        for (size_t l : Range(SIMD<double>::Size()))
+          if (fabs(vals(k)[l] - 1.0) > 1e-12)
+            throw Exception("LimitTent: first basis function is not constant 1");
+    }
+#endif
+
+  Cyl2Tent(tent, tstar, uhat, u, lh);
+
+  // element means of the cylinder variable before limiting, values of u
+  // at the integration points and element means of u
+  FlatMatrix<> uhatmean(nels, COMP, lh);
+  Array<FlatMatrix<SIMD<double>>> upts(nels);
+  FlatMatrix<> umean(nels, COMP, lh);
+  for (size_t i : Range(nels))
+    {
+      upts[i].AssignMemory(COMP, fedata->miri[i]->Size(), lh);
+      calc_mean(i, uhat, upts[i], uhatmean.Row(i));
+      calc_mean(i, u, upts[i], umean.Row(i));
+    }
+
+  Vec<COMP> umin, umax;
+  for (size_t c : Range(COMP))
+    {
+      umin(c) = umax(c) = umean(0,c);
+      for (size_t i : Range(nels))
+        {
+          umin(c) = min2(umin(c), umean(i,c));
+          umax(c) = max2(umax(c), umean(i,c));
+        }
+    }
+
+  bool changed = false;
+  FlatVector<> theta(COMP, lh);
+  for (size_t i : Range(nels))
+    {
+      auto pts = upts[i];
+      auto mean = umean.Row(i);
+      theta = 1.0;
+      if (limit_bounds)
+        for (size_t c : Range(COMP))
+          {
+            const double dmax = umax(c) - mean(c), dmin = umin(c) - mean(c);
+            SIMD<double> th(1.0);
+            for (size_t k : Range(pts.Width()))
+              {
+                auto d = pts(c,k) - mean(c);
+                th = IfPos(d - dmax, min(th, dmax/d), th);
+                th = IfPos(dmin - d, min(th, dmin/d), th);
+              }
+            for (size_t l : Range(SIMD<double>::Size()))
+              theta(c) = min2(theta(c), th[l]);
+            for (size_t k : Range(pts.Width()))
+              pts(c,k) = mean(c) + theta(c) * (pts(c,k) - mean(c));
+          }
+      if (limit_positivity)
+        Cast().PositivityTheta(mean, pts, theta);
+
+      bool limited = false;
+      for (size_t c : Range(COMP))
+        if (theta(c) < 1.0 - 1e-12)
+          limited = true;
+      if (!limited)
+        continue;
+
+      IntRange dn = fedata->ranges[i];
+      for (size_t c : Range(COMP))
+        {
+          u.Col(c).Range(dn) *= theta(c);
+          u(dn.First(), c) += (1.0 - theta(c)) * mean(c);
+        }
+      changed = true;
+    }
+  if (!changed)
+    return false;
+
+  // The conserved quantity is the cylinder variable ĝ(u) = u - ∇φ⋅f(u),
+  // which is nonlinear in u: restore its element means after the map
+  // back, so that the limiter does not change the mass of any element.
+  Tent2Cyl(tent, tstar, u, uhat, true, lh);
+  FlatVector<> newmean(COMP, lh);
+  for (size_t i : Range(nels))
+    {
+      calc_mean(i, uhat, upts[i], newmean);
+      uhat.Row(fedata->ranges[i].First()) += uhatmean.Row(i) - newmean;
+    }
+  return true;
+}
+
+template <typename EQUATION, int DIM, int COMP, int ECOMP, bool SYMBOLIC>
+int T_ConservationLaw<EQUATION, DIM, COMP, ECOMP, SYMBOLIC>::
+SolveViscosityTent (const Tent & tent, FlatMatrixFixWidth<COMP> u,
+                    FlatMatrixFixWidth<COMP> ubnd, FlatVector<double> nu,
+                    double tau, LocalHeap & lh, double tol, int maxit)
+{
+  auto fedata = tent.fedata;
+  if (!fedata) throw Exception("fedata not set");
+
+  HeapReset hr(lh);
+  const int ndof = fedata->nd;
+  FlatMatrixFixWidth<COMP> r(ndof,lh), z(ndof,lh), p(ndof,lh), q(ndof,lh);
+
+  // K = M + tau A is symmetric positive definite for the symmetric
+  // interior penalty form and the constant nu of a tent.  Starting from
+  // the old values, the residual M u + tau g - K u is -tau (A u - g).
+  auto applyK = [&] (FlatMatrixFixWidth<COMP> x, FlatMatrixFixWidth<COMP> kx)
     {
-      SolveM (tent, i, fedata->adelta[i], visc.Rows (tent.fedata->ranges[i]), lh);
+      // ubnd = 0 gives the linear part of the operator
+      z = 0.0;
+      CalcViscosityTent (tent, x, z, nu, kx, lh, false);
+      kx *= tau;
+      z = x;
+      for (int i : Range (tent.els))
+        ApplyM (tent, i, fedata->adelta[i], z.Rows (fedata->ranges[i]), lh);
+      kx += z;
+    };
+  auto precond = [&] (FlatMatrixFixWidth<COMP> x)
+    {
+      for (int i : Range (tent.els))
+        SolveM (tent, i, fedata->adelta[i], x.Rows (fedata->ranges[i]), lh);
+    };
+
+  CalcViscosityTent (tent, u, ubnd, nu, r, lh, false);
+  r *= -tau;
+  z = r;
+  precond(z);
+  p = z;
+  double rz = InnerProduct (AsFV(r), AsFV(z));
+  const double rz0 = rz;
+  if (rz0 <= 0.0)
+    return 0;
+
+  int it = 0;
+  while (it < maxit && rz > sqr(tol) * rz0)
+    {
+      applyK(p, q);
+      double alpha = rz / InnerProduct (AsFV(p), AsFV(q));
+      u += alpha * p;
+      r -= alpha * q;
+      z = r;
+      precond(z);
+      double rznew = InnerProduct (AsFV(r), AsFV(z));
+      p *= rznew / rz;
+      p += z;
+      rz = rznew;
+      it++;
     }
+  return it;
 }
 
 template <typename EQUATION, int DIM, int COMP, int ECOMP, bool SYMBOLIC>
@@ -529,18 +745,9 @@ CalcEntropyResidualTent (const Tent & tent, FlatMatrixFixWidth<COMP> u,
 	    {
 	      if(cf_numentropyflux)
 		{
-		  ArrayMem<int,2> elnums;
-		  ArrayMem<int,8> selvnums;
-		  ma->GetFacetSurfaceElements (tent.internal_facets[i], elnums);
-
-		  ElementId sei(BND, elnums[0]);
-		  ElementTransformation & strafo = ma->GetTrafo (sei, lh);
-		  selvnums = ma->GetElVertices (sei);
-		  Facet2SurfaceElementTrafo stransform(strafo.GetElementType(), selvnums);
-		  auto & ir_facet_surf = stransform(*fedata->fir[i], lh);
-		  auto & smir = strafo(ir_facet_surf, lh);
-		  smir.GetNormals() = simd_mir1.GetNormals(); // outward normal
-		  
+		  ElementTransformation & strafo = *fedata->strafoi[i];
+		  auto & smir = *fedata->msfiri[i];
+
 		  ProxyUserData ud(1, lh);
 		  ud.fel = &fel1;
 		  const_cast<ElementTransformation&>(strafo).userdata = &ud;
@@ -701,22 +908,10 @@ Cyl2Tent (const Tent & tent, double tstar,
       tstar*fedata->agradphi_top[i];
 
     if constexpr(SYMBOLIC) {
-      // Make ProxyUserData to embed in mir's trafo with space to store 
-      // u-values  and grad(φ)-values for τ = tstar (given).
-      // So we create ProxyUserData with
-      //   number of trial proxy functions = 1,  and 
-      //   number of coefficient functions = 1:       
-      ProxyUserData * ud = new (lh) ProxyUserData(1, 1, lh); 
-      auto & trafo = *fedata->trafoi[i];
-      const_cast<ElementTransformation&>(trafo).userdata = ud;
-      ud->fel = &fel;
-      auto nip = simd_mir.IR().GetNIP();
-
-      // reserve space for u-values of the size nip x COMP
-      ud->AssignMemory(proxy_u.get(), nip, COMP, lh);
-
-      // reserve space for gradphi-values of the size nip x DIM	
-      ud->AssignMemory(tps->cfgradphi.get(), nip, DIM, lh);
+      // Embed the tent's ProxyUserData in mir's trafo, with space to store
+      // u-values and grad(φ)-values for τ = tstar (given). The inverse map
+      // overwrites u_ipts, so u is not evaluated into the proxy memory here.
+      GetUserData(tent, i, false, simd_mir.IR(), lh);
     }
     
     fel.Evaluate(simd_mir.IR(), uhat.Rows(dn), u_ipts);
@@ -751,21 +946,16 @@ ApplyM1 (const Tent & tent, double tstar, FlatMatrixFixWidth<COMP> u,
       const SIMD_IntegrationRule & simd_ir = *fedata->iri[i];
       IntRange dn = fedata->ranges[i];
 
-      FlatMatrix<SIMD<double>> u_ipts(COMP, simd_ir.Size(), lh),
-                               temp(COMP, simd_ir.Size(), lh);
+      // symbolic: evaluate u directly into the proxy memory
+      FlatMatrix<SIMD<double>> u_ipts = SYMBOLIC
+	? GetUserData(tent, i, false, simd_ir, lh).GetAMemory(proxy_u.get())
+	: FlatMatrix<SIMD<double>>(COMP, simd_ir.Size(), lh);
+      FlatMatrix<SIMD<double>> temp(COMP, simd_ir.Size(), lh);
       FlatMatrix<SIMD<double>> flux(COMP*DIM, simd_ir.Size(), lh);
       FlatMatrix<SIMD<double>> graddelta_mat(DIM, simd_ir.Size(), lh);
       graddelta_mat = fedata->agradphi_top[i] - fedata->agradphi_bot[i];
 
       auto & simd_mir = *fedata->miri[i];
-      if constexpr(SYMBOLIC)
-	{
-	  ProxyUserData * ud = new (lh) ProxyUserData(1, lh);
-	  auto & trafo = *fedata->trafoi[i];
-	  const_cast<ElementTransformation&>(trafo).userdata = ud;
-	  ud->fel = &fel;
-	  ud->AssignMemory (proxy_u.get(), simd_ir.GetNIP(), COMP, lh);
-	}
       fel.Evaluate (simd_ir, u.Rows(dn), u_ipts);
       Cast().Flux(simd_mir,u_ipts,flux);
 
@@ -807,7 +997,10 @@ Tent2Cyl (const Tent & tent, double tstar,
 
       IntRange dn = fedata->ranges[i];
 
-      FlatMatrix<SIMD<double>> u_ipts(COMP, simd_ir.Size(), lh);
+      // symbolic: evaluate u directly into the proxy memory
+      FlatMatrix<SIMD<double>> u_ipts = SYMBOLIC
+	? GetUserData(tent, i, false, simd_ir, lh).GetAMemory(proxy_u.get())
+	: FlatMatrix<SIMD<double>>(COMP, simd_ir.Size(), lh);
       FlatMatrix<SIMD<double>> flux(COMP*DIM, simd_ir.Size(), lh),
                                res(COMP, simd_ir.Size(), lh);
       FlatMatrix<SIMD<double>> gradphi_mat(DIM, simd_ir.Size(), lh);
@@ -815,14 +1008,6 @@ Tent2Cyl (const Tent & tent, double tstar,
                     tstar*fedata->agradphi_top[i];
 
       auto & simd_mir = *fedata->miri[i];
-      if constexpr(SYMBOLIC)
-	{
-	  ProxyUserData * ud = new (lh) ProxyUserData(1, lh);
-	  auto & trafo = *fedata->trafoi[i];
-	  const_cast<ElementTransformation&>(trafo).userdata = ud;
-	  ud->fel = &fel;
-	  ud->AssignMemory (proxy_u.get(), simd_ir.GetNIP(), COMP, lh);
-	}
       fel.Evaluate (simd_ir, u.Rows(dn), u_ipts);
       Cast().Flux(simd_mir,u_ipts,flux);
 
@@ -844,6 +1029,392 @@ Tent2Cyl (const Tent & tent, double tstar,
     }
 }
 
+template <typename EQUATION, int DIM, int COMP, int ECOMP, bool SYMBOLIC>
+void T_ConservationLaw<EQUATION, DIM, COMP, ECOMP, SYMBOLIC>::
+ImplicitSourceTent (const Tent & tent, double tstar, double tau,
+                    FlatMatrixFixWidth<COMP> u, LocalHeap & lh)
+{
+  auto fedata = tent.fedata;
+  if (!fedata) throw Exception("fedata not set");
+
+  const int maxit = 20;
+  const double tol = 1e-12;
+  for (size_t i : Range(tent.els))
+    {
+      HeapReset hr(lh);
+      auto & fel = static_cast<const BaseScalarFiniteElement&> (*fedata->fei[i]);
+      auto & simd_mir = *fedata->miri[i];
+      IntRange dn = fedata->ranges[i];
+      const size_t nip = simd_mir.Size();
+
+      if constexpr(SYMBOLIC)
+        GetUserData(tent, i, false, simd_mir.IR(), lh);
+
+      FlatMatrix<SIMD<double>> u0(COMP, nip, lh), w(COMP, nip, lh),
+                               wh(COMP, nip, lh), ghat0(COMP, nip, lh),
+                               res(COMP, nip, lh), ds(COMP*COMP, nip, lh),
+                               dg(COMP*COMP, nip, lh), flux(COMP*DIM, nip, lh),
+                               fluxh(COMP*DIM, nip, lh);
+      FlatMatrix<SIMD<double>> gradphi(DIM, nip, lh);
+      gradphi = (1-tstar)*fedata->agradphi_bot[i] + tstar*fedata->agradphi_top[i];
+      fel.Evaluate(simd_mir.IR(), u.Rows(dn), u0);
+      w = u0;
+
+      // mapped variable ĝ(v) = v - ∇φ⋅f(v) at all points
+      auto mapped = [&] (FlatMatrix<SIMD<double>> v, FlatMatrix<SIMD<double>> fv,
+                         FlatMatrix<SIMD<double>> g)
+        {
+          Cast().Flux(simd_mir, v, fv);
+          for (size_t k : Range(nip))
+            for (size_t c : Range(COMP))
+              {
+                SIMD<double> hsum(0.0);
+                for (size_t l : Range(DIM))
+                  hsum += gradphi(l,k) * fv(DIM*c+l,k);
+                g(c,k) = v(c,k) - hsum;
+              }
+        };
+      mapped(u0, flux, ghat0);
+
+      // the substep advances the physical time by tau*delta
+      FlatVector<SIMD<double>> dt(nip, lh);
+      dt = tau * fedata->adelta[i];
+
+      // Newton's method for ĝ(w) - dt s(w) = ĝ(u0) at each point
+      for (int it = 0; it < maxit; it++)
+        {
+          Cast().Source(simd_mir, w, res);
+          mapped(w, flux, wh);
+          SIMD<double> err(0.0), scale(1.0);
+          for (size_t k : Range(nip))
+            for (size_t c : Range(COMP))
+              {
+                res(c,k) = wh(c,k) - dt(k) * res(c,k) - ghat0(c,k);
+                err = max(err, fabs(res(c,k)));
+                scale = max(scale, fabs(ghat0(c,k)));
+              }
+          bool converged = true;
+          for (size_t l : Range(SIMD<double>::Size()))
+            if (err[l] > tol * scale[l])
+              converged = false;
+          if (converged)
+            break;
+
+          // dĝ/du = I - ∇φ⋅f'(u), f' by finite differences
+          Cast().SourceJacobian(simd_mir, w, ds);
+          for (size_t c : Range(COMP))
+            {
+              wh = w;
+              for (size_t k : Range(nip))
+                wh(c,k) += 1e-7 * (1.0 + fabs(w(c,k)));
+              Cast().Flux(simd_mir, wh, fluxh);
+              for (size_t k : Range(nip))
+                for (size_t r : Range(COMP))
+                  {
+                    SIMD<double> hsum(0.0);
+                    for (size_t l : Range(DIM))
+                      hsum += gradphi(l,k) * (fluxh(DIM*r+l,k) - flux(DIM*r+l,k));
+                    dg(COMP*r+c,k) = -hsum / (wh(c,k) - w(c,k));
+                  }
+            }
+
+          for (size_t k : Range(nip))
+            {
+              Mat<COMP,COMP,SIMD<double>> jac;
+              Vec<COMP,SIMD<double>> x = res.Col(k);
+              for (size_t r : Range(COMP))
+                for (size_t c : Range(COMP))
+                  jac(r,c) = (r == c ? 1.0 : 0.0) + dg(COMP*r+c,k)
+                    - dt(k) * ds(COMP*r+c,k);
+
+              // Gauss elimination without pivoting, fine for the
+              // diagonally dominant I - ∇φ⋅f' - dt ds/du of dissipative
+              // sources on causal tents
+              for (size_t r : Range(COMP))
+                for (size_t r2 : Range(r+1, COMP))
+                  {
+                    auto fac = jac(r2,r) / jac(r,r);
+                    for (size_t c : Range(r, COMP))
+                      jac(r2,c) -= fac * jac(r,c);
+                    x(r2) -= fac * x(r);
+                  }
+              for (int r = COMP-1; r >= 0; r--)
+                {
+                  for (size_t c : Range(r+1, COMP))
+                    x(r) -= jac(r,c) * x(c);
+                  x(r) /= jac(r,r);
+                }
+              w.Col(k) -= x;
+            }
+        }
+
+      for (size_t k : Range(nip))
+        w.Col(k) *= simd_mir[k].GetWeight();
+      u.Rows(dn) = 0.0;
+      fel.AddTrans(simd_mir.IR(), w, u.Rows(dn));
+      SolveM(tent, i, u.Rows(dn), lh);
+    }
+}
+
+template <typename EQUATION, int DIM, int COMP, int ECOMP, bool SYMBOLIC>
+void T_ConservationLaw<EQUATION, DIM, COMP, ECOMP, SYMBOLIC>::
+RecordProbes (const Tent & tent, const BaseVector & hu, double tstar,
+              FlatMatrixFixWidth<COMP> uhat, LocalHeap & lh)
+{
+  if (probe_el.Size() == 0 || &hu != u.get())
+    return;
+  bool found = false;
+  for (int el : tent.els)
+    if (el_probes[el].Size())
+      found = true;
+  if (!found)
+    return;
+
+  HeapReset hr(lh);
+  auto fedata = tent.fedata;
+  FlatMatrixFixWidth<COMP> local_u(fedata->nd, lh);
+  Cyl2Tent(tent, tstar, uhat, local_u, lh);
+
+  // The fronts are linear on each element: the bottom front is the
+  // interpolant of gftau at the neighbours and of timebot at the tent
+  // vertex (CalcFluxTent overwrites gftau there during the substeps),
+  // the height of the tent is (ttop-tbot) times the barycentric
+  // coordinate of its vertex.  The reference vertices of a simplex are
+  // the unit vectors and the origin, so the barycentric coordinates are
+  // ip(0),...,ip(DIM-1) and 1-sum.  Tents sharing an element depend on
+  // each other, so the samples of a probe are appended in time order by
+  // one thread.
+  auto tau = gftau->GetVector().FVDouble();
+  for (size_t i : Range(tent.els))
+    for (int p : el_probes[tent.els[i]])
+      {
+        const IntegrationPoint & ip = probe_ip[p];
+        auto vnums = ma->GetElVertices(ElementId(VOL, tent.els[i]));
+        double tbot = 0, lamvertex = 0, lamlast = 1;
+        for (size_t k : Range(vnums))
+          {
+            double lam = (k < DIM) ? ip(k) : lamlast;
+            if (k < DIM)
+              lamlast -= ip(k);
+            int v = tent.vmap[vnums[k]];
+            tbot += lam * ((v == tent.vertex) ? tent.timebot : tau(v));
+            if (v == tent.vertex)
+              lamvertex = lam;
+          }
+        double delta = lamvertex * (tent.ttop - tent.tbot);
+        if (delta <= 0)
+          continue;   // the probe is on the bottom of the tent only
+
+        auto & fel = static_cast<const BaseScalarFiniteElement&> (*fedata->fei[i]);
+        IntRange dn = fedata->ranges[i];
+        probe_times[p].Append(tbot + tstar * delta);
+        for (size_t c : Range(COMP))
+          probe_values[p].Append(fel.Evaluate(ip, local_u.Rows(dn).Col(c)));
+      }
+}
+
+template <typename EQUATION, int DIM, int COMP, int ECOMP, bool SYMBOLIC>
+Array<std::pair<string,double>> T_ConservationLaw<EQUATION, DIM, COMP, ECOMP, SYMBOLIC>::
+Timing (int reps, LocalHeap & lh)
+{
+  const char * names[] = { "TentDataFE", "Cyl2Tent", "ApplyM1", "CalcFluxTent",
+                           "Tent2Cyl", "SolveM", "LimitTent", "Viscosity" };
+  enum { FEDATA, CYL2TENT, APPLYM1, FLUX, TENT2CYL, SOLVEM, LIMIT, VISC, NKERNELS };
+  // the limiter and the viscosity path (one explicit viscosity step, as
+  // in a substep of the tent solvers) are timed only if they are switched on
+  const bool limiter = limit_positivity || limit_bounds;
+  const bool viscosity = ECOMP > 0 && entropy_viscosity;
+  reps = max(reps, 1);
+  if (tentsolver)
+    tentsolver->Setup();
+
+  // InitTent and CalcFluxTent write the tent times into gftau: run the
+  // tents in the order of their dependencies, as Propagate does, and
+  // restore the front afterwards
+  Vector<> tau_saved = gftau->GetVector().FVDouble();
+
+  Matrix<> times(TaskManager::GetNumThreads(), NKERNELS);
+  times = 0.0;
+  RunParallelDependency
+    (tent_dependency, [&] (int i)
+     {
+       LocalHeap slh = lh.Split();
+       auto t = times.Row(TaskManager::GetThreadId());
+       double start = WallTime();
+       Tent tent = tps->GetTent(i);
+       tent.fedata = new (slh) TentDataFE(tent, *fes, slh);
+       tent.InitTent(gftau);
+       InitUserData(tent, slh);
+       t(FEDATA) += WallTime() - start;
+
+       const int ndof = tent.fedata->nd;
+       FlatMatrixFixWidth<COMP> uhat(ndof, slh), ut(ndof, slh),
+         u0(ndof, slh), res(ndof, slh);
+       u->GetIndirect(tent.fedata->dofs, AsFV(uhat));
+       uinit->GetIndirect(tent.fedata->dofs, AsFV(u0));
+
+       auto time = [&] (int kernel, auto func)
+         {
+           double start = WallTime();
+           for (int k = 0; k < reps; k++)
+             {
+               HeapReset hr(slh);
+               func();
+             }
+           t(kernel) += (WallTime() - start) / reps;
+         };
+       time(CYL2TENT, [&] { Cyl2Tent(tent, 0.5, uhat, ut, slh); });
+       time(APPLYM1, [&] { ApplyM1(tent, 0.5, ut, res, slh); });
+       time(FLUX, [&] { CalcFluxTent(tent, ut, u0, res, 0.5, 0, slh); });
+       time(TENT2CYL, [&] { Tent2Cyl(tent, 0.5, ut, res, true, slh); });
+       time(SOLVEM, [&]
+            {
+              res = ut;
+              for (int j : Range(tent.els))
+                SolveM(tent, j, res.Rows(tent.fedata->ranges[j]), slh);
+            });
+       if (limiter)
+         time(LIMIT, [&]
+              {
+                res = uhat;
+                LimitTent(tent, 0.5, res, ut, slh);
+              });
+       if (viscosity)
+         {
+           FlatMatrixFixWidth<COMP> dudt(ndof, slh), visc(ndof, slh);
+           FlatMatrixFixWidth<ECOMP> eres(ndof, slh);
+           FlatVector<> nu_tent(tent.els.Size(), slh);
+           Cyl2Tent(tent, 0.5, uhat, ut, slh);
+           CalcFluxTent(tent, ut, u0, dudt, 0.5, 0, slh);
+           time(VISC, [&]
+                {
+                  CalcEntropyResidualTent(tent, uhat, dudt, eres, u0, 0.5, slh);
+                  nu_tent = CalcViscosityCoefficientTent(tent, uhat, eres, 0.5, slh);
+                  Cyl2Tent(tent, 0.5, uhat, ut, slh);
+                  CalcViscosityTent(tent, ut, ut, nu_tent, visc, slh);
+                  ut -= 1e-3 * visc;
+                  Tent2Cyl(tent, 0.5, ut, res, true, slh);
+                });
+         }
+       tent.fedata = nullptr;
+       tent.SetFinalTime();
+     });
+  gftau->GetVector().FVDouble() = tau_saved;
+
+  Array<std::pair<string,double>> result;
+  for (int k : Range(NKERNELS))
+    {
+      if ((k == LIMIT && !limiter) || (k == VISC && !viscosity))
+        continue;
+      double sum = 0;
+      for (size_t j : Range(times.Height()))
+        sum += times(j,k);
+      result.Append(std::make_pair(string(names[k]), sum));
+    }
+  return result;
+}
+
+template <typename EQUATION, int DIM, int COMP, int ECOMP, bool SYMBOLIC>
+bool T_ConservationLaw<EQUATION, DIM, COMP, ECOMP, SYMBOLIC>::
+HasSlices (const Tent & tent, const BaseVector & hu) const
+{
+  if (slice_times.Size() == 0 || &hu != u.get())
+    return false;
+  auto tau = gftau->GetVector().FVDouble();
+  double tmin = tent.timebot;
+  double tmax = tent.timebot + (tent.ttop - tent.tbot);
+  for (int nb : tent.nbv)
+    {
+      tmin = min2(tmin, tau(tent.vmap[nb]));
+      tmax = max2(tmax, tau(tent.vmap[nb]));
+    }
+  for (double t : slice_times)
+    if (t >= tmin && t < tmax)
+      return true;
+  return false;
+}
+
+template <typename EQUATION, int DIM, int COMP, int ECOMP, bool SYMBOLIC>
+void T_ConservationLaw<EQUATION, DIM, COMP, ECOMP, SYMBOLIC>::
+SliceTent (const Tent & tent, double tstar0, double tstar1,
+           FlatMatrixFixWidth<COMP> uhat0, FlatMatrixFixWidth<COMP> uhat1,
+           LocalHeap & lh)
+{
+  auto fedata = tent.fedata;
+  if (!fedata) throw Exception("fedata not set");
+
+  HeapReset hr(lh);
+  FlatMatrixFixWidth<COMP> u0(fedata->nd, lh), u1(fedata->nd, lh);
+  Cyl2Tent(tent, tstar0, uhat0, u0, lh);
+  Cyl2Tent(tent, tstar1, uhat1, u1, lh);
+
+  // Tents sharing an element depend on each other, so the right hand
+  // side of an element is not updated by two threads at the same time.
+  // The points of the element are distributed among its tents by the
+  // half-open time intervals [bot(x), top(x)).
+  auto tau = gftau->GetVector().FVDouble();
+  for (size_t i : Range(tent.els))
+    {
+      HeapReset hr(lh);
+      auto & fel = static_cast<const BaseScalarFiniteElement&> (*fedata->fei[i]);
+      auto & simd_mir = *fedata->miri[i];
+      auto & simd_ir = simd_mir.IR();
+      IntRange dn = fedata->ranges[i];
+      const size_t nip = simd_ir.Size();
+
+      // bottom front at the points, interpolated from the vertex values
+      // (timebot at the tent vertex, CalcFluxTent overwrites gftau there)
+      FlatVector<SIMD<double>> bot(nip, lh);
+      bot = SIMD<double>(0.0);
+      auto vnums = ma->GetElVertices(ElementId(VOL, tent.els[i]));
+      for (size_t k : Range(nip))
+        {
+          SIMD<double> lamlast(1.0);
+          for (size_t j : Range(vnums))
+            {
+              SIMD<double> lam = (j < DIM) ? simd_ir[k](j) : lamlast;
+              if (j < DIM)
+                lamlast -= simd_ir[k](j);
+              int v = tent.vmap[vnums[j]];
+              bot(k) += lam * ((v == tent.vertex) ? tent.timebot : tau(v));
+            }
+        }
+      FlatVector<SIMD<double>> delta = fedata->adelta[i];
+
+      FlatMatrix<SIMD<double>> vals0(COMP, nip, lh), vals1(COMP, nip, lh);
+      fel.Evaluate(simd_ir, u0.Rows(dn), vals0);
+      fel.Evaluate(simd_ir, u1.Rows(dn), vals1);
+      FlatMatrixFixWidth<COMP> rhs(dn.Size(), lh);
+
+      for (size_t n : Range(slice_times))
+        {
+          bool found = false;
+          FlatMatrix<SIMD<double>> vals(COMP, nip, lh);
+          for (size_t k : Range(nip))
+            {
+              SIMD<double> d = If(delta(k) > SIMD<double>(0.0), delta(k), SIMD<double>(1.0));
+              SIMD<double> ts = If(delta(k) > SIMD<double>(0.0),
+                                   (slice_times[n] - bot(k)) / d, SIMD<double>(-1.0));
+              SIMD<double> w = If(ts >= SIMD<double>(tstar0),
+                                  If(ts < SIMD<double>(tstar1), simd_mir[k].GetWeight(),
+                                     SIMD<double>(0.0)),
+                                  SIMD<double>(0.0));
+              SIMD<double> s = (ts - tstar0) / (tstar1 - tstar0);
+              for (size_t c : Range(COMP))
+                vals(c,k) = w * (vals0(c,k) + s * (vals1(c,k) - vals0(c,k)));
+              for (size_t l : Range(SIMD<double>::Size()))
+                if (w[l] != 0.0)
+                  found = true;
+            }
+          if (!found)
+            continue;
+          rhs = 0.0;
+          fel.AddTrans(simd_ir, vals, rhs);
+          slice_gfs[n]->GetVector().AddIndirect(fedata->dofs.Range(dn), AsFV(rhs));
+        }
+    }
+}
+
 ////////////////////////////////////////////////////////////////
 // time stepping methods 
 ////////////////////////////////////////////////////////////////
@@ -859,16 +1430,55 @@ Propagate(LocalHeap & lh, shared_ptr<GridFunction> hdgf)
       vis3d->SetInitialHd(gfu, hdgf, lh);
 
   tentsolver->Setup();
+  tentsolver->ResetViscIterations();
+  if (has_source && !tentsolver->implicit_source)
+    throw Exception("source terms need the IMEX tent solver");
+  if (tentsolver->adaptive)
+    tentsolver->SetLocalBounds(*tps, lh);
+  tent_substeps.SetSize(tps->GetNTents());
+
+  const double tslab = GetTime();
+  for (size_t n : Range(slice_times))
+    {
+      if (slice_times[n] < tslab || slice_times[n] >= tslab + tps->GetSlabHeight())
+        throw Exception("output time " + ToString(slice_times[n]) + " not in the slab ["
+                        + ToString(tslab) + ", " + ToString(tslab + tps->GetSlabHeight()) + ")");
+      slice_gfs[n]->GetVector() = 0.0;
+    }
 
   RunParallelDependency
     (tent_dependency, [&] (int i)
      {
        LocalHeap slh = lh.Split();  // split to threads
        Tent tent = tps->GetTent(i);
-       tentsolver->PropagateTent(tent, *u, *uinit, slh);
+       // geometry of the tent is set up once for u and all ensemble members
+       tent.fedata = new (slh) TentDataFE(tent, *fes, slh);
+       tent.InitTent(gftau);
+       InitUserData(tent, slh);
+       {
+         HeapReset hr(slh);
+         tentsolver->PropagateTent(tent, *u, *uinit, slh);
+       }
+       for (size_t k : Range(ensemble_vecs))
+         {
+           HeapReset hr(slh);
+           tentsolver->PropagateTent(tent, *ensemble_vecs[k],
+                                     *ensemble_vecs_init[k], slh);
+         }
+       tent.fedata = nullptr;
+       tent.SetFinalTime();
+       tent_substeps[i] = tentsolver->TentSubsteps(tent);
        if (hdgf != nullptr)
          vis3d->SetForTent(tent, gfu, hdgf, slh);
      });
+
+  // L2 projection of the output slices
+  for (auto & gf : slice_gfs)
+    fes->SolveM(nullptr, gf->GetVector(), nullptr, lh);
+
+  slab_time += tps->GetSlabHeight();
+  if (snapshots)
+    snapshots->Slab(GetTime(), *u);
 }
 
 #endif // CONSERVATIONLAW_TP_IMPL
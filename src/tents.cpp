@@ -1,33 +1,14 @@
 #include "tents.hpp"
+#include "vtuwriter.hpp"
 #include <limits>
+#include <algorithm>
+#include <map>
+#include <shared_mutex>
 #include <h1lofe.hpp> // seems needed for ScalarFE (post 2021-06-22 NGSolve update)
 
 
 
 ///////////////////// GradPhiCoefficientFunction ///////////////////////////
-template<typename TFunc>
-void TraverseDimensions_old( FlatArray<int> dims, const TFunc &func)
-
-{
-switch(dims.Size())
-{
-  case 0:
-    func(0,0,0);
-    break;
-  case 1:
-    for (int i : Range(max2(1, dims[0])))
-      func(i,i,0);
-    break;
-  case 2:
-    for (int i : Range(max2(1, dims[0])))
-      for (int j : Range(max2(1, dims[1])))
-        func(i*dims[1]+j, i, j);
-    break;
-  default:
-    throw Exception("TraverseDimensions: too many dimensions!");
-}
-}
-
 void GradPhiCoefficientFunction::GenerateCode(Code &code, FlatArray<int> inputs, int index) const
 {
   auto dims = Dimensions();
@@ -93,6 +74,22 @@ constexpr ELEMENT_TYPE EL_TYPE(int DIM)
   return DIM == 1 ? ET_SEGM : DIM == 2 ? ET_TRIG : ET_TET;
 }//this assumes that there is only one type of element per mesh
 
+template <int DIM>
+static TentSlabPitcher * CreateSlabPitcher(ngstents::PitchingMethod method,
+                                           shared_ptr<MeshAccess> ma, Array<int> & vmap)
+{
+  switch (method)
+    {
+    case ngstents::EVolGrad:
+      return new VolumeGradientPitcher<DIM>(ma, vmap);
+    case ngstents::EEdgeGrad:
+      return new EdgeGradientPitcher<DIM>(ma, vmap);
+    default:
+      cout << "Trying to pitch tent without setting a pitching method." << endl;
+      return nullptr;
+    }
+}
+
 template <int DIM>
 bool TentPitchedSlab::PitchTents(const double dt, const bool calc_local_ct, const double global_ct)
 {
@@ -105,20 +102,7 @@ bool TentPitchedSlab::PitchTents(const double dt, const bool calc_local_ct, cons
       throw std::logic_error("Wavespeed has not been set!");
     }
   this->dt = dt; // set it so that GetSlabHeight can return it
-  TentSlabPitcher * slabpitcher = [this]() ->TentSlabPitcher* {
-    switch (this->method)
-      {
-      case ngstents::EVolGrad:
-        return new VolumeGradientPitcher<DIM>(this->ma, vmap);
-        break;
-      case ngstents::EEdgeGrad:
-        return new EdgeGradientPitcher<DIM>(this->ma, vmap);
-      default:
-        cout << "Trying to pitch tent without setting a pitching method." << endl;
-        return nullptr;
-        break;
-      }
-  }();
+  TentSlabPitcher * slabpitcher = CreateSlabPitcher<DIM>(method, ma, vmap);
   if(!slabpitcher) return false;
   cout << "Created slab pitcher"<<endl;
   //calc wavespeed for each element and perhaps other stuff (i..e, calculating edge gradients, checking fine edges, etc)
@@ -302,38 +286,8 @@ bool TentPitchedSlab::PitchTents(const double dt, const bool calc_local_ct, cons
         }
     }
   delete slabpitcher;
-  
-
-  // set lists of internal facets of each element of each tent
-  ParallelFor
-    (Range(tents),
-     [&] (int i)
-     {
-       Tent & tent = *tents[i];
-       TableCreator<int> elfnums_creator(tent.els.Size());
 
-       for ( ; !elfnums_creator.Done(); elfnums_creator++)  {
-	 for(int j : Range(tent.els)) {
-
-	   auto fnums = ma->GetElFacets (tent.els[j]);
-	   for(int fnum : fnums)
-	     if (tent.internal_facets.Pos(fnum) !=
-                 tent.internal_facets.ILLEGAL_POSITION)
-	       elfnums_creator.Add(j,fnum);
-	 }
-       }
-       tent.elfnums = elfnums_creator.MoveTable();
-     });
-
-  // build dependency graph (used by RunParallelDependency)
-  TableCreator<int> create_dag(tents.Size());
-  for ( ; !create_dag.Done(); create_dag++)
-    {
-      for (int i : tents.Range())
-	for (int d : tents[i]->dependent_tents)
-	  create_dag.Add(i, d);
-    }
-  tent_dependency = create_dag.MoveTable();
+  FinalizeTents();
 
   // calculate slope of tents
   ParallelFor
@@ -378,6 +332,65 @@ template bool TentPitchedSlab::PitchTents<2>(const double, const bool, const dou
 template bool TentPitchedSlab::PitchTents<3>(const double, const bool, const double);
 
 
+template <int DIM>
+double TentPitchedSlab::TimePoleHeight(const bool calc_local_ct, const double global_ct,
+                                       int reps)
+{
+  if(cmax == nullptr)
+    throw std::logic_error("Wavespeed has not been set!");
+  unique_ptr<TentSlabPitcher> slabpitcher(CreateSlabPitcher<DIM>(method, ma, vmap));
+  if(!slabpitcher) return 0.0;
+  Table<int> v2v, v2e;
+  std::tie(v2v,v2e) = slabpitcher->InitializeMeshData<DIM>(lh,cmax, calc_local_ct, global_ct);
+  Array<double> tau(ma->GetNV());
+  tau = 0.0;
+
+  reps = max(reps, 1);
+  double start = WallTime();
+  for (int k = 0; k < reps; k++)
+    slabpitcher->ComputeVerticesReferenceHeight(v2v, v2e, tau, lh);
+  return (WallTime() - start) / reps;
+}
+template double TentPitchedSlab::TimePoleHeight<1>(const bool, const double, int);
+template double TentPitchedSlab::TimePoleHeight<2>(const bool, const double, int);
+template double TentPitchedSlab::TimePoleHeight<3>(const bool, const double, int);
+
+
+void TentPitchedSlab::FinalizeTents()
+{
+  // set lists of internal facets of each element of each tent
+  ParallelFor
+    (Range(tents),
+     [&] (int i)
+     {
+       Tent & tent = *tents[i];
+       TableCreator<int> elfnums_creator(tent.els.Size());
+
+       for ( ; !elfnums_creator.Done(); elfnums_creator++)  {
+	 for(int j : Range(tent.els)) {
+
+	   auto fnums = ma->GetElFacets (tent.els[j]);
+	   for(int fnum : fnums)
+	     if (tent.internal_facets.Pos(fnum) !=
+                 tent.internal_facets.ILLEGAL_POSITION)
+	       elfnums_creator.Add(j,fnum);
+	 }
+       }
+       tent.elfnums = elfnums_creator.MoveTable();
+     });
+
+  // build dependency graph (used by RunParallelDependency)
+  TableCreator<int> create_dag(tents.Size());
+  for ( ; !create_dag.Done(); create_dag++)
+    {
+      for (int i : tents.Range())
+	for (int d : tents[i]->dependent_tents)
+	  create_dag.Add(i, d);
+    }
+  tent_dependency = create_dag.MoveTable();
+}
+
+
 double TentPitchedSlab::MaxSlope() const
 {
   double maxgrad = 0.0;
@@ -389,6 +402,82 @@ double TentPitchedSlab::MaxSlope() const
 }
 
 
+TentTables TentPitchedSlab::GetTentTables() const
+{
+  TentTables tt;
+  const size_t ntents = tents.Size();
+  tt.vertex.SetSize(ntents);
+  tt.level.SetSize(ntents);
+  tt.tbot.SetSize(ntents);
+  tt.ttop.SetSize(ntents);
+  tt.maxslope.SetSize(ntents);
+  tt.dt = dt;
+  tt.nlayers = nlayers;
+  tt.vmap = vmap;
+
+  // row sizes first, then fill the rows of all tables in parallel
+  Array<int> nnbv(ntents), nels(ntents), nfacets(ntents), ndep(ntents);
+  ParallelFor
+    (Range(tents), [&] (size_t i)
+     {
+       const Tent & tent = *tents[i];
+       tt.vertex[i] = tent.vertex;
+       tt.level[i] = tent.level;
+       tt.tbot[i] = tent.tbot;
+       tt.ttop[i] = tent.ttop;
+       nnbv[i] = tent.nbv.Size();
+       nels[i] = tent.els.Size();
+       nfacets[i] = tent.internal_facets.Size();
+       ndep[i] = tent.dependent_tents.Size();
+     });
+  tt.nbv = Table<int>(nnbv);
+  tt.nbtime = Table<double>(nnbv);
+  tt.els = Table<int>(nels);
+  tt.internal_facets = Table<int>(nfacets);
+  tt.dependent_tents = Table<int>(ndep);
+  ParallelFor
+    (Range(tents), [&] (size_t i)
+     {
+       const Tent & tent = *tents[i];
+       tt.maxslope[i] = tent.maxslope;
+       tt.nbv[i] = tent.nbv;
+       tt.nbtime[i] = tent.nbtime;
+       tt.els[i] = tent.els;
+       tt.internal_facets[i] = tent.internal_facets;
+       tt.dependent_tents[i] = tent.dependent_tents;
+     });
+  return tt;
+}
+
+
+void TentPitchedSlab::SetTentTables(const TentTables & tt)
+{
+  tents.DeleteAll();
+  dt = tt.dt;
+  nlayers = tt.nlayers;
+  vmap = tt.vmap;
+  tents.SetSize(tt.vertex.Size());
+  ParallelFor
+    (Range(tents), [&] (size_t i)
+     {
+       Tent * tent = new Tent(vmap);
+       tent->vertex = tt.vertex[i];
+       tent->level = tt.level[i];
+       tent->tbot = tt.tbot[i];
+       tent->ttop = tt.ttop[i];
+       tent->maxslope = tt.maxslope[i];
+       tent->nbv = tt.nbv[i];
+       tent->nbtime = tt.nbtime[i];
+       tent->els = tt.els[i];
+       tent->internal_facets = tt.internal_facets[i];
+       tent->dependent_tents = tt.dependent_tents[i];
+       tents[i] = tent;
+     });
+  FinalizeTents();
+  has_been_pitched = true;
+}
+
+
 ///////////////////// Pitching Algo Routines ///////////////////////////////
 TentSlabPitcher::TentSlabPitcher(shared_ptr<MeshAccess> ama, ngstents::PitchingMethod m, Array<int> &avmap) : ma(ama), vertex_refdt(ama->GetNV()), edge_len(ama->GetNEdges()), local_ctau([](const int, const int){return 1.;}), method(m), vmap(avmap) {
   if(method == ngstents::PitchingMethod::EEdgeGrad){ cmax.SetSize(ma->GetNEdges());}
@@ -1073,6 +1162,157 @@ void TentPitchedSlab::DrawPitchedTentsVTK(string filename)
 }
 
 
+void TentPitchedSlab::DrawPitchedTentsVTU(string filename, bool compress,
+                                          int nparts, FlatArray<double> active_times)
+{
+  const int dim = ma->GetDimension();
+  if (nparts <= 0)
+    nparts = TaskManager::GetNumThreads();
+
+  auto point = [&] (int v)
+    {
+      Vec<3> p = 0.0;
+      switch (dim)
+        {
+        case 1: p(0) = ma->GetPoint<1>(v)(0); break;
+        case 2: p.Range(0,2) = ma->GetPoint<2>(v); break;
+        default: p = ma->GetPoint<3>(v);
+        }
+      return p;
+    };
+
+  // tent elements in space, with bottom and top times at the vertices
+  auto add_spatial = [&] (VTUPiece & piece, int i)
+    {
+      const Tent & tent = GetTent(i);
+      auto & tbot = piece.PointData("tbot", 1).values;
+      auto & ttop = piece.PointData("ttop", 1).values;
+      auto & level = piece.CellData("tentlevel", 1).values;
+      auto & tentnr = piece.CellData("tentnumber", 1).values;
+      ArrayMem<size_t, 8> pnums;
+      for (int elnr : tent.els)
+        {
+          ElementId ei(VOL, elnr);
+          pnums.SetSize0();
+          for (int v : ma->GetElVertices(ei))
+            {
+              pnums.Append(piece.AddPoint(point(v)));
+              if (vmap[v] == tent.vertex)
+                {
+                  tbot.Append(tent.tbot);
+                  ttop.Append(tent.ttop);
+                }
+              else
+                {
+                  double t = tent.nbtime[tent.nbv.Pos(vmap[v])];
+                  tbot.Append(t);
+                  ttop.Append(t);
+                }
+            }
+          piece.AddCell(VTKCellType(ma->GetElType(ei)), pnums);
+          level.Append(tent.level);
+          tentnr.Append(i);
+        }
+    };
+
+  // space-time cells of a tent in 1D (triangles) and 2D (tetrahedra)
+  auto add_spacetime = [&] (VTUPiece & piece, int i)
+    {
+      const Tent & tent = GetTent(i);
+      auto & level = piece.CellData("tentlevel", 1).values;
+      auto & tentnr = piece.CellData("tentnumber", 1).values;
+      auto add_cell = [&] (uint8_t type, FlatArray<size_t> pnums)
+        {
+          piece.AddCell(type, pnums);
+          level.Append(tent.level);
+          tentnr.Append(i);
+        };
+      for (int elnr : tent.els)
+        {
+          auto vnums = ma->GetElVertices(ElementId(VOL, elnr));
+          int k = 0;
+          while (vmap[vnums[k]] != tent.vertex)
+            k++;
+          Vec<3> pv = point(vnums[k]);
+          size_t pbot, ptop;
+          if (dim == 1)
+            {
+              pbot = piece.AddPoint(Vec<3>(pv(0), tent.tbot, 0));
+              ptop = piece.AddPoint(Vec<3>(pv(0), tent.ttop, 0));
+            }
+          else
+            {
+              pbot = piece.AddPoint(Vec<3>(pv(0), pv(1), tent.tbot));
+              ptop = piece.AddPoint(Vec<3>(pv(0), pv(1), tent.ttop));
+            }
+          // points of the other vertices, in the order of the element
+          ArrayMem<size_t, 4> nbp;
+          for (int j : Range(1, vnums.Size()))
+            {
+              int v = vnums[(k+j) % vnums.Size()];
+              double t = tent.nbtime[tent.nbv.Pos(vmap[v])];
+              Vec<3> p = point(v);
+              nbp.Append(piece.AddPoint(dim == 1 ? Vec<3>(p(0), t, 0)
+                                        : Vec<3>(p(0), p(1), t)));
+            }
+          if (dim == 1)
+            {
+              size_t tri[] = { pbot, ptop, nbp[0] };
+              add_cell(5, FlatArray<size_t>(3, tri));
+            }
+          else
+            // fan of triangles from the tent vertex (quads give two)
+            for (int j : Range(nbp.Size()-1))
+              {
+                size_t tet[] = { pbot, ptop, nbp[j], nbp[j+1] };
+                add_cell(10, FlatArray<size_t>(4, tet));
+              }
+        }
+    };
+
+  auto tentrange = [&] (int part)
+    { return IntRange(0, GetNTents()).Split(part, nparts); };
+
+  // all pieces (also empty ones) define the same data arrays
+  auto declare = [] (VTUPiece & piece, bool spatial)
+    {
+      if (spatial)
+        {
+          piece.PointData("tbot", 1);
+          piece.PointData("ttop", 1);
+        }
+      piece.CellData("tentlevel", 1);
+      piece.CellData("tentnumber", 1);
+    };
+
+  if (active_times.Size() == 0)
+    WriteVTU (filename, nparts, compress, [&] (int part, VTUPiece & piece)
+              {
+                declare(piece, dim > 2);
+                for (int i : tentrange(part))
+                  if (dim <= 2)
+                    add_spacetime(piece, i);
+                  else
+                    add_spatial(piece, i);
+              });
+
+  // the tents whose pole contains the time, each with its full spatial
+  // patch: the patches overlap, this is not a cut of the slab at the time
+  for (int k : Range(active_times))
+    WriteVTU (filename + "_active" + ToString(k), nparts, compress,
+              [&] (int part, VTUPiece & piece)
+              {
+                declare(piece, true);
+                for (int i : tentrange(part))
+                  {
+                    const Tent & tent = GetTent(i);
+                    if (tent.tbot <= active_times[k] && active_times[k] < tent.ttop)
+                      add_spatial(piece, i);
+                  }
+              });
+}
+
+
 // Used with OpenGL (ngsgui/tents_visualization) and WebGL (webgui).
 void TentPitchedSlab::
 DrawPitchedTentsGL(Array<int> & tentdata, Array<double> & tenttimes, int & nlevels)
@@ -1126,6 +1366,66 @@ ostream & operator<< (ostream & ost, const Tent & tent)
 }
 
 
+///////////// TentRules ////////////////////////////////////////////////////
+
+
+TentRules::TentRules (ELEMENT_TYPE et, int order)
+  : nfacets{ElementTopology::GetNFacets(et)},
+    irel(et, 2*order),
+    irfacet(ElementTopology::GetFacetType(et, 0), 2*order+1),
+    // at most 4! vertex orders of nfacets transformed rules each
+    lh(16384 + 24*nfacets*(4096 + 2*irfacet.Size()*sizeof(SIMD<IntegrationPoint>)),
+       "TentRules")
+{
+  int nv = ElementTopology::GetNVertices(et);
+  if (nv != ElementTopology::GetSpaceDim(et)+1)
+    throw Exception("tent integration rules: only simplices are supported");
+  irfacet.SetIRX(nullptr); // quick fix to avoid usage of TP elements (slows down)
+
+  irfacet_el.SetSize((1 << (nv*(nv-1)/2)) * nfacets);
+  irfacet_el = nullptr;
+  Array<int> vnums(nv);
+  for (int j : Range(nv))
+    vnums[j] = j;
+  do
+    {
+      Facet2ElementTrafo transform(et, vnums);
+      int first = VertexOrder(vnums)*nfacets;
+      for (int k : Range(nfacets))
+        irfacet_el[first+k] = &transform(k, irfacet, lh);
+    }
+  while (std::next_permutation(vnums.Data(), vnums.Data()+nv));
+}
+
+const TentRules & TentRules::Get (ELEMENT_TYPE et, int order)
+{
+  static std::shared_mutex mutex;
+  static std::map<std::pair<ELEMENT_TYPE,int>, unique_ptr<TentRules>> rules;
+  auto key = std::make_pair(et, order);
+  {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    auto pos = rules.find(key);
+    if (pos != rules.end())
+      return *pos->second;
+  }
+  std::unique_lock<std::shared_mutex> lock(mutex);
+  auto & r = rules[key];
+  if (!r)
+    r.reset(new TentRules(et, order));
+  return *r;
+}
+
+int TentRules::VertexOrder (FlatArray<int> vnums)
+{
+  int code = 0, bit = 0;
+  for (size_t j = 0; j < vnums.Size(); j++)
+    for (size_t l = j+1; l < vnums.Size(); l++, bit++)
+      if (vnums[j] > vnums[l])
+        code |= 1 << bit;
+  return code;
+}
+
+
 ///////////// TentDataFE ///////////////////////////////////////////////////
 
 
@@ -1148,7 +1448,9 @@ TentDataFE::TentDataFE(const Tent & tent, const FESpace & fes, LocalHeap & lh)
     agradphi_botf2(tent.internal_facets.Size(), lh),
     agradphi_topf2(tent.internal_facets.Size(), lh),
     anormals(tent.internal_facets.Size(), lh),
-    adelta_facet(tent.internal_facets.Size(), lh)
+    adelta_facet(tent.internal_facets.Size(), lh),
+    strafoi(tent.internal_facets.Size(), lh),
+    msfiri(tent.internal_facets.Size(), lh)
 {
   auto & ma = fes.GetMeshAccess();
   int dim = ma->GetDimension();
@@ -1170,7 +1472,7 @@ TentDataFE::TentDataFE(const Tent & tent, const FESpace & fes, LocalHeap & lh)
       dofs += dnums;
 
       fei[i] = &fes.GetFE (ei, lh);
-      iri[i] = new (lh) SIMD_IntegrationRule(fei[i]->ElementType(),2*order);
+      iri[i] = &TentRules::Get(fei[i]->ElementType(), order).Element();
       trafoi[i] = &ma->GetTrafo (ei, lh);
       miri[i] =  &(*trafoi[i]) (*iri[i], lh);
 
@@ -1259,18 +1561,12 @@ TentDataFE::TentDataFE(const Tent & tent, const FESpace & fes, LocalHeap & lh)
               auto & trafo = *trafoi[felpos[i][j]];
 
               auto vnums = ma->GetElVertices (elnums[j]);
-              Facet2ElementTrafo transform(trafo.GetElementType(), vnums);
-
-              auto etfacet = ElementTopology::
-		GetFacetType (trafo.GetElementType(), loc_facetnr[j]);
+              auto & rules = TentRules::Get(trafo.GetElementType(), order);
 
               if(j == 0)
-                {
-		  fir[i] = new (lh) SIMD_IntegrationRule (etfacet, 2*order+1);
-		  fir[i]->SetIRX(nullptr); // quick fix to avoid usage of TP elements (slows down)
-                }
+                fir[i] = &rules.Facet();
 
-	      firi[i][j] = &transform(loc_facetnr[j], *fir[i], lh);
+	      firi[i][j] = &rules.FacetOnElement(loc_facetnr[j], vnums);
 	      auto nipt = firi[i][j]->Size();
               if(j == 0)
                 {
@@ -1304,6 +1600,27 @@ TentDataFE::TentDataFE(const Tent & tent, const FESpace & fes, LocalHeap & lh)
                 }
             }
         }
+
+      // boundary facet: map the facet integration rule to the surface
+      // element once, it is reused in every stage and substep
+      strafoi[i] = nullptr;
+      msfiri[i] = nullptr;
+      if(felpos[i][1] == size_t(-1))
+        {
+          ArrayMem<int,2> selnums;
+          ma->GetFacetSurfaceElements (tent.internal_facets[i], selnums);
+          if(selnums.Size())
+            {
+              ElementId sei(BND, selnums[0]);
+              strafoi[i] = &ma->GetTrafo (sei, lh);
+              auto selvnums = ma->GetElVertices (sei);
+              Facet2SurfaceElementTrafo stransform(strafoi[i]->GetElementType(),
+                                                   selvnums);
+              auto & ir_facet_surf = stransform(*fir[i], lh);
+              msfiri[i] = &(*strafoi[i])(ir_facet_surf, lh);
+              msfiri[i]->GetNormals() = mfiri1[i]->GetNormals(); // outward normal
+            }
+        }
     }
 }
 
@@ -61,6 +61,42 @@ public:
 ostream & operator<< (ostream & ost, const Tent & tent);
 
 
+////////////////////////////////////////////////////////////////////////////
+///
+/// Integration rules of TentDataFE for one element type and order,
+/// shared by all tents.  The rules are created once and never changed,
+/// hence a rule of the tent kernels is identified by its address (see
+/// CoefficientCache).  Only simplices are supported.
+///
+class TentRules
+{
+  int nfacets;
+  SIMD_IntegrationRule irel;     ///< element rule of order 2*order
+  SIMD_IntegrationRule irfacet;  ///< facet rule of order 2*order+1
+  LocalHeap lh;                  ///< memory of the rules in irfacet_el
+  /// irfacet transformed to local facet k of an element, at
+  /// VertexOrder(vnums)*nfacets+k
+  Array<const SIMD_IntegrationRule*> irfacet_el;
+
+  TentRules (ELEMENT_TYPE et, int order);
+
+public:
+  /// the rules for et and order, created on the first call
+  static const TentRules & Get (ELEMENT_TYPE et, int order);
+
+  /// the transformation of a facet to an element depends only on the
+  /// order of the vertex numbers: bit j of the result is set if the
+  /// j-th pair of vertices is not in ascending order
+  static int VertexOrder (FlatArray<int> vnums);
+
+  const SIMD_IntegrationRule & Element () const { return irel; }
+  const SIMD_IntegrationRule & Facet () const { return irfacet; }
+  /// the facet rule on local facet k of an element with vertices vnums
+  const SIMD_IntegrationRule & FacetOnElement (int k, FlatArray<int> vnums) const
+  { return *irfacet_el[VertexOrder(vnums)*nfacets + k]; }
+};
+
+
 ////////////////////////////////////////////////////////////////////////////
 ///
 /// Class with dofs, finite element & integration info for a tent:
@@ -74,8 +110,8 @@ public:
   Array<IntRange> ranges;
   /// finite elements for all elements in the tent
   Array<FiniteElement*> fei;
-  /// integration rules for all elements in the tent
-  Array<SIMD_IntegrationRule*> iri;
+  /// integration rules for all elements in the tent (see TentRules)
+  Array<const SIMD_IntegrationRule*> iri;
   /// mapped integration rules for all elements in the tent
   Array<SIMD_BaseMappedIntegrationRule*> miri;
   /// element transformations for all elements in the tent
@@ -91,7 +127,7 @@ public:
   /// local numbers of the neighbors
   Array<INT<2,size_t>> felpos;
   /// facet integration rules for all facets in the tent
-  Array<SIMD_IntegrationRule*> fir;
+  Array<const SIMD_IntegrationRule*> fir;
   /// facet integration rules for all internal facets in the tent
   /// transformed to local coordinates of the two neighboring elements
   Array<Vec<2,const SIMD_IntegrationRule*>> firi;
@@ -108,10 +144,47 @@ public:
   Array<FlatMatrix<SIMD<double>>> anormals;
   /// height of the tent in the IP's
   Array<FlatVector<SIMD<double>>> adelta_facet;
+  /// surface element transformations for boundary facets (nullptr otherwise)
+  Array<ElementTransformation*> strafoi;
+  /// facet integration rules mapped to the surface elements of boundary
+  /// facets, with outward normals set (nullptr otherwise)
+  Array<SIMD_BaseMappedIntegrationRule*> msfiri;
+
+  /// reusable ProxyUserData of symbolic conservation laws for the element
+  /// and the facet integration rules (see T_ConservationLaw::InitUserData)
+  ProxyUserData * ud_el = nullptr;
+  ProxyUserData * ud_facet = nullptr;
 
   TentDataFE(const Tent & tent, const FESpace & fes, LocalHeap & lh);
 };
 
+////////////////////////////////////////////////////////////////////////////
+///
+/// Call func(index, i, j) for all entries of a CoefficientFunction with
+/// dimensions "dims", in the naming scheme of the generated code variables.
+///
+template<typename TFunc>
+void TraverseDimensions_old( FlatArray<int> dims, const TFunc &func)
+{
+  switch(dims.Size())
+    {
+    case 0:
+      func(0,0,0);
+      break;
+    case 1:
+      for (int i : Range(max2(1, dims[0])))
+        func(i,i,0);
+      break;
+    case 2:
+      for (int i : Range(max2(1, dims[0])))
+        for (int j : Range(max2(1, dims[1])))
+          func(i*dims[1]+j, i, j);
+      break;
+    default:
+      throw Exception("TraverseDimensions: too many dimensions!");
+    }
+}
+
 ////////////////////////////////////////////////////////////////////////////
 ///
 /// Class representing the spatial gradient of the advancing front
@@ -161,6 +234,31 @@ namespace ngstents{
   enum PitchingMethod {EVolGrad =1, EEdgeGrad};
 }
 
+/// All tents of a slab in flat arrays, the per-tent arrays in compressed
+/// row storage (see TentPitchedSlab::GetTentTables)
+struct TentTables
+{
+  double dt = 0;
+  int nlayers = 0;
+  Array<int> vmap;
+  Array<int> vertex, level;
+  Array<double> tbot, ttop, maxslope;
+  Table<int> nbv;
+  Table<double> nbtime;         ///< same rows as nbv
+  Table<int> els;
+  Table<int> internal_facets;
+  Table<int> dependent_tents;
+};
+
+/// Space-time mesh of a tent-pitched slab (see TentPitchedSlab::ToSpaceTimeMesh)
+struct SpaceTimeMesh
+{
+  shared_ptr<MeshAccess> mesh;
+  /// idx3d[front][spatial H1 dof] = {space-time H1 dof}, empty rows for
+  /// vertices which are not pitched in this front (front 0 is the base)
+  Array<shared_ptr<Table<int>>> idx3d;
+};
+
 class TentPitchedSlab {
 protected:
   double dt;                              // time step between two time slices
@@ -173,6 +271,9 @@ protected:
   Array<int> vmap;                        // vertex map for periodic boundaries
   LocalHeap lh;
 
+  // element facets and dependency graph of the tents
+  void FinalizeTents();
+
 public:
   // access to base spatial mesh (public for export to Python visualization)
   shared_ptr<MeshAccess> ma;
@@ -196,6 +297,12 @@ public:
   //its return value will indicate whether the slab was successfully pitched.
   template <int DIM>
   bool PitchTents(const double dt, const bool calc_local_ct, const double global_ct = 1.0);
+
+  // seconds for one evaluation of the pole heights of all vertices on the
+  // flat front (GetPoleHeight), the average of reps evaluations; for
+  // benchmarks, the tents are not changed
+  template <int DIM>
+  double TimePoleHeight(const bool calc_local_ct, const double global_ct, int reps);
   
   // Get object features
   int GetNTents() { return tents.Size(); }
@@ -203,6 +310,9 @@ public:
 
   void SetMaxWavespeed(const double c){cmax =  make_shared<ConstantCoefficientFunction>(c);}
   void SetMaxWavespeed(shared_ptr<CoefficientFunction> c){ cmax = c;}
+  shared_ptr<CoefficientFunction> GetMaxWavespeed() const { return cmax; }
+  // vertex map for periodic boundaries (master vertex of each vertex)
+  const Array<int> & GetVertexMap() const { return vmap; }
   
   double GetSlabHeight() { return dt; }
   const Tent & GetTent(int i) { return *tents[i];}
@@ -213,10 +323,25 @@ public:
   // Drawing
   void DrawPitchedTents(int level=1) ;
   void DrawPitchedTentsVTK(string vtkfilename);
+  // binary VTU (see WriteVTU): space-time cells in 1D/2D, the spatial
+  // elements of the tents in 3D, or the (overlapping) spatial patches of
+  // the tents active at the given times
+  void DrawPitchedTentsVTU(string filename, bool compress, int nparts,
+                           FlatArray<double> active_times);
   void DrawPitchedTentsGL(Array<int> & tentdata,
                           Array<double> & tenttimes, int & nlevels);
 
   void SetPitchingMethod(ngstents::PitchingMethod amethod) {this->method = amethod;}
+
+  // the tents in flat arrays, filled in parallel
+  TentTables GetTentTables() const;
+  // replace the tents by the given ones (e.g. from a checkpoint)
+  void SetTentTables(const TentTables & tt);
+
+  // space-time mesh of the slab (1D and 2D spatial meshes), with the time
+  // coordinate scaled by tscale, and the dof maps of H1 of the given
+  // order (1 or 2) from the fronts of the slab to the space-time mesh
+  SpaceTimeMesh ToSpaceTimeMesh(double tscale = 1.0, int order = 1) const;
 };
 
 //Abstract class with the interface of methods used for pitching a tent
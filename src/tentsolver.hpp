@@ -1,15 +1,86 @@
 #ifndef TENTSOLVER_HPP
 #define TENTSOLVER_HPP
 
+#include <atomic>
+
 template <typename EQUATION, int DIM, int COMP, int ECOMP, bool SYMBOLIC> class T_ConservationLaw;
 
 class TentSolver
 {
+protected:
+  int substeps = 1;      // (maximal) number of substeps within each tent
+
 public:
+  bool adaptive = false; // scale the substeps of a tent by its local bound
+  Array<double> vertex_speed; // wavespeed around each vertex, set for adaptive
+  double maxbound = 0.0; // maximal wavespeed x slope of the tents of the slab
+  bool implicit_visc = false; // one implicit solve per substep for the
+                              // entropy viscosity instead of explicit steps
+  // maximal number of CG iterations of the implicit viscosity solves
+  // since the last ResetViscIterations
+  std::atomic<int> max_visc_iterations{0};
+  bool implicit_source = false; // implicit source step after each substep (IMEX)
+
   TentSolver() = default;
+  TentSolver(int asubsteps) : substeps{asubsteps} { };
 
   virtual void Setup() { };
 
+  void ResetViscIterations () { max_visc_iterations = 0; }
+  void CountViscIterations (int it)
+  {
+    int old = max_visc_iterations;
+    while (it > old && !max_visc_iterations.compare_exchange_weak(old, it))
+      ;
+  }
+
+  // The stable pseudo-time step of a tent is bounded by the local
+  // wavespeed (maximum at the centers of the elements around its vertex,
+  // as for pitching) times its slope (ratio of height to mesh size).
+  double LocalBound (const Tent & tent) const
+  {
+    return vertex_speed[tent.vertex] * tent.MaxSlope();
+  }
+
+  // local wavespeeds and maximal bound of the slab for adaptive substeps
+  void SetLocalBounds (TentPitchedSlab & tps, LocalHeap & lh)
+  {
+    auto ma = tps.ma;
+    auto cmax = tps.GetMaxWavespeed();
+    vertex_speed.SetSize(ma->GetNV());
+    vertex_speed = 0.0;
+    for (auto el : ma->Elements(VOL))
+      {
+        HeapReset hr(lh);
+        ElementTransformation & trafo = ma->GetTrafo(el, lh);
+        IntegrationRule ir(trafo.GetElementType(), 0);
+        double c = cmax ? cmax->Evaluate(trafo(ir[0], lh)) : 1.0;
+        for (auto v : el.Vertices())
+          vertex_speed[v] = max(vertex_speed[v], c);
+      }
+    maxbound = 0.0;
+    if (tps.GetNTents() == 0)
+      return;
+    // periodic vertices: tents are pitched at the master vertices
+    auto & vmap = tps.GetTent(0).vmap;
+    for (auto v : Range(ma->GetNV()))
+      vertex_speed[vmap[v]] = max(vertex_speed[vmap[v]], vertex_speed[v]);
+    for (int i : Range(tps.GetNTents()))
+      maxbound = max(maxbound, LocalBound(tps.GetTent(i)));
+  }
+
+  // Number of substeps used for the tent. In adaptive mode, the tent
+  // with the maximal local bound gets all substeps, the others
+  // proportionally fewer, but at least one.
+  int TentSubsteps (const Tent & tent) const
+  {
+    if (!adaptive || maxbound <= 0.0)
+      return substeps;
+    int n = int(ceil(substeps * LocalBound(tent) / maxbound));
+    return max(1, min(substeps, n));
+  }
+
+  // propagate hu through the tent, tent.fedata is set up by the caller
   virtual void PropagateTent(const Tent & tent, BaseVector & hu,
 			     const BaseVector & hu0, LocalHeap & lh) = 0;
 };
@@ -19,7 +90,6 @@ class SAT : public TentSolver
 {
 protected:
   const int stages;
-  const int substeps;
 
   // pointer to T_ConservationLaw
   shared_ptr<TCONSLAW> tcl;
@@ -27,7 +97,7 @@ protected:
   
 public:
   SAT (const shared_ptr<TCONSLAW> & atcl, int astages, int asubsteps)
-    : tcl{atcl}, stages{astages}, substeps{asubsteps}
+    : TentSolver(asubsteps), tcl{atcl}, stages{astages}
   {
     cout << "set up structure-aware Taylor time stepping with "+
       ToString(stages)+" stages and "+ToString(substeps)+" substeps within each tent" << endl;
@@ -51,7 +121,6 @@ class SARK : public TentSolver
 {
 protected:
   const int stages;
-  const int substeps;
 
   // pointer to T_ConservationLaw
   shared_ptr<TCONSLAW> tcl;
@@ -66,7 +135,7 @@ public:
   Vector<> ccoeff;
 
   SARK (const shared_ptr<TCONSLAW> & atcl, int astages, int asubsteps)
-    : tcl{atcl}, stages{astages}, substeps{asubsteps}
+    : TentSolver(asubsteps), tcl{atcl}, stages{astages}
   {
     shared_ptr<L2HighOrderFESpace> fes_check = dynamic_pointer_cast<L2HighOrderFESpace>(atcl->fes);
     if(!fes_check)
@@ -130,5 +199,70 @@ public:
   void PropagateTent(const Tent & tent, BaseVector & hu,
 		     const BaseVector & hu0, LocalHeap & lh) override;
 };
+
+// Low-storage version of SARK with the same coefficients (and order).
+// Each stage s adds its contributions
+//     τ (a(r,s) fu + d(r,s) M1u)
+// to the stage values U[r] of the later stages r > s right after it has
+// been computed, and τ b(s) fu directly to the solution, so that only
+// one u, M1u and fu register is needed.  M1u is computed only if a
+// later stage uses it.
+//
+// Memory per tent, in matrices of size ndof x COMP (ndof = # dofs of
+// the tent), allocated on the LocalHeap of the thread:
+//
+//                         SARK            LSSARK
+//   stage registers       4*stages        stages-1
+//   other                 8               5
+//   total, 3 stages       20              7
+//   total, 5 stages       28              9
+//   entropy viscosity     ndof x ECOMP    4 + ndof x ECOMP
+//   (ECOMP > 0)           (always)        (only if enabled)
+//   slices (SliceTent)    1               1
+//   limiter or source     -               1
+//
+// E.g. a 3D tent of 30 elements of order 4 (35 dofs each) and 5 Euler
+// components takes 28*1050*5*8 bytes = 1.2 MB with SARK and 0.38 MB with
+// LSSARK, which fits into the L2 cache of most cores.
+template <typename TCONSLAW>
+class LSSARK : public SARK<TCONSLAW>
+{
+  using SARK<TCONSLAW>::COMP;
+  using SARK<TCONSLAW>::ECOMP;
+  using SARK<TCONSLAW>::tcl;
+  using SARK<TCONSLAW>::stages;
+  using SARK<TCONSLAW>::acoeff;
+  using SARK<TCONSLAW>::dcoeff;
+  using SARK<TCONSLAW>::bcoeff;
+  using SARK<TCONSLAW>::ccoeff;
+
+public:
+  LSSARK (const shared_ptr<TCONSLAW> & atcl, int astages, int asubsteps)
+    : SARK<TCONSLAW>(atcl, astages, asubsteps)
+  {
+    cout << "using the low-storage implementation" << endl;
+  };
+
+  void PropagateTent(const Tent & tent, BaseVector & hu,
+		     const BaseVector & hu0, LocalHeap & lh) override;
+};
+
+// IMEX splitting for d_t u + div F(u) = s(u) with stiff sources: each
+// substep of LSSARK advances the flux part explicitly, followed by one
+// implicit Euler step of the source for the mapped variable of the tent,
+// solved pointwise at the integration points (see ImplicitSourceTent).  The splitting is first
+// order in time, but the stability of the substeps does not depend on
+// the source.
+template <typename TCONSLAW>
+class IMEX : public LSSARK<TCONSLAW>
+{
+public:
+  IMEX (const shared_ptr<TCONSLAW> & atcl, int astages, int asubsteps)
+    : LSSARK<TCONSLAW>(atcl, astages, asubsteps)
+  {
+    this->implicit_source = true;
+    cout << "with implicit source terms" << endl;
+  };
+};
   
 #endif //TENTSOLVER_HPP
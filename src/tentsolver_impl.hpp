@@ -16,8 +16,6 @@ void SAT<TCONSLAW>::PropagateTent(const Tent & tent, BaseVector & hu,
   // static Timer tproptent ("SAT::Propagate Tent", 2);
   // ThreadRegionTimer reg(tproptent, TaskManager::GetThreadId());
 
-  tent.fedata = new (lh) TentDataFE(tent, *(tcl->fes), lh);
-  tent.InitTent(tcl->gftau);
 
   int ndof = tent.fedata->nd;
   FlatMatrixFixWidth<COMP> local_uhat(ndof,lh);
@@ -26,13 +24,23 @@ void SAT<TCONSLAW>::PropagateTent(const Tent & tent, BaseVector & hu,
   hu.GetIndirect(tent.fedata->dofs, AsFV(local_uhat));
   hu0.GetIndirect(tent.fedata->dofs, AsFV(local_u0));
   local_u0temp = local_u0;
+
+  // state at the beginning of the substep, for output slices (see SliceTent)
+  const bool slices = tcl->HasSlices(tent, hu);
+  FlatMatrixFixWidth<COMP> local_prev;
+  if (slices)
+    {
+      local_prev.AssignMemory(ndof, lh);
+      local_prev = local_uhat;
+    }
   
   FlatMatrixFixWidth<COMP> local_uhat1(ndof,lh);
   FlatMatrixFixWidth<COMP> local_u(ndof,lh);
   FlatMatrixFixWidth<COMP> local_help(ndof,lh);
   
-  double taustar = 1.0/substeps;
-  for (int j = 0; j < substeps; j++)
+  const int nsub = TentSubsteps(tent);
+  double taustar = 1.0/nsub;
+  for (int j = 0; j < nsub; j++)
     {
       local_uhat1 = local_uhat;
       double fac = 1.0;
@@ -52,10 +60,16 @@ void SAT<TCONSLAW>::PropagateTent(const Tent & tent, BaseVector & hu,
   	    }
   	  local_u0 = 0.0;
   	}
+      if (tcl->limit_positivity || tcl->limit_bounds)
+	tcl->LimitTent (tent, (j+1)*taustar, local_uhat, local_u, lh);
+      tcl->RecordProbes (tent, hu, (j+1)*taustar, local_uhat, lh);
+      if (slices)
+	{
+	  tcl->SliceTent (tent, j*taustar, (j+1)*taustar, local_prev, local_uhat, lh);
+	  local_prev = local_uhat;
+	}
     }
   hu.SetIndirect(tent.fedata->dofs, AsFV(local_uhat));
-  tent.fedata = nullptr;
-  tent.SetFinalTime();
 };
 
 ////// structure-aware Runge-Kutta time stepping //////
@@ -66,8 +80,6 @@ void SARK<TCONSLAW>::PropagateTent(const Tent & tent, BaseVector & hu,
   // static Timer tproptent ("SARK::Propagate Tent", 2);
   // ThreadRegionTimer reg(tproptent, TaskManager::GetThreadId());
 
-  tent.fedata = new (lh) TentDataFE(tent, *(tcl->fes), lh);
-  tent.InitTent(tcl->gftau);
 
   const int ndof = tent.fedata->nd;
   FlatMatrixFixWidth<COMP> local_u0(ndof,lh);
@@ -77,6 +89,15 @@ void SARK<TCONSLAW>::PropagateTent(const Tent & tent, BaseVector & hu,
   hu.GetIndirect(tent.fedata->dofs, AsFV(local_Gu0));
   hu0.GetIndirect(tent.fedata->dofs, AsFV(local_init));
 
+  // state at the beginning of the substep, for output slices (see SliceTent)
+  const bool slices = tcl->HasSlices(tent, hu);
+  FlatMatrixFixWidth<COMP> local_prev;
+  if (slices)
+    {
+      local_prev.AssignMemory(ndof, lh);
+      local_prev = local_Gu0;
+    }
+
   FlatMatrixFixWidth<COMP> local_u(ndof,lh);
   FlatMatrixFixWidth<COMP> local_help(ndof,lh);
   FlatMatrixFixWidth<COMP> local_flux(ndof,lh);
@@ -114,8 +135,9 @@ void SARK<TCONSLAW>::PropagateTent(const Tent & tent, BaseVector & hu,
   // tcl->Tent2Cyl(tent, 0, local_u0, local_help, false, lh);
   // double norm_bot = InnerProduct(AsFV(local_u0),AsFV(local_help));
 
-  const double taustar = 1.0/substeps;
-  for (int j = 0; j < substeps; j++)
+  const int nsub = TentSubsteps(tent);
+  const double taustar = 1.0/nsub;
+  for (int j = 0; j < nsub; j++)
     {
       Uhat = local_Gu0;
       for ( auto s : Range(stages) )
@@ -136,7 +158,7 @@ void SARK<TCONSLAW>::PropagateTent(const Tent & tent, BaseVector & hu,
       // for viscosity
       dUhatdt = fu[0];
 
-      if (ECOMP > 0)
+      if (ECOMP > 0 && tcl->entropy_viscosity)
 	{
 	  /////// use dUhatdt as approximation at the final time
 	  // U[0] = local_Gu0;
@@ -154,22 +176,37 @@ void SARK<TCONSLAW>::PropagateTent(const Tent & tent, BaseVector & hu,
 	  double nu_tent = tcl->CalcViscosityCoefficientTent(tent, U[0], res,j*taustar, lh);
 
 	  local_nu = nu_tent;
-	  double steps_visc = (40*tau_tent*nu_tent/tau_visc1)/substeps;
+	  double steps_visc = (40*tau_tent*nu_tent/tau_visc1)/nsub;
 	  if (steps_visc > 0.2)
 	    {
-	      steps_visc = max(1.0,ceil(steps_visc));
-	      double tau_visc = taustar/steps_visc;
 	      // store boundary conditions in local_help
 	      tcl->Cyl2Tent (tent, (j+1)*taustar, local_Gu0, local_u, lh);
 	      local_help = local_u;
-	      for (int k = 0; k < steps_visc; k++)
+	      if (this->implicit_visc)
+		this->CountViscIterations
+		  (tcl->SolveViscosityTent (tent, local_u, local_help, local_nu, taustar, lh));
+	      else
 		{
-		  tcl->CalcViscosityTent (tent, local_u, local_help, local_nu, local_flux, lh);
-		  local_u -= tau_visc * local_flux;
+		  steps_visc = max(1.0,ceil(steps_visc));
+		  double tau_visc = taustar/steps_visc;
+		  for (int k = 0; k < steps_visc; k++)
+		    {
+		      tcl->CalcViscosityTent (tent, local_u, local_help, local_nu, local_flux, lh);
+		      local_u -= tau_visc * local_flux;
+		    }
 		}
 	      tcl->Tent2Cyl(tent, (j+1)*taustar, local_u, local_Gu0, true, lh);
 	    }
 	}
+
+      if (tcl->limit_positivity || tcl->limit_bounds)
+	tcl->LimitTent (tent, (j+1)*taustar, local_Gu0, local_u, lh);
+      tcl->RecordProbes (tent, hu, (j+1)*taustar, local_Gu0, lh);
+      if (slices)
+	{
+	  tcl->SliceTent (tent, j*taustar, (j+1)*taustar, local_prev, local_Gu0, lh);
+	  local_prev = local_Gu0;
+	}
     }
 
   // // calc |u|_M1 norm on advancing front
@@ -186,9 +223,154 @@ void SARK<TCONSLAW>::PropagateTent(const Tent & tent, BaseVector & hu,
   //   *testout << "bot, top : " << norm_bot << ", " << norm_top << endl;
 
   hu.SetIndirect(tent.fedata->dofs, AsFV(local_Gu0));
-  tent.fedata = nullptr;
-  tent.SetFinalTime();
 };
 
 
+////// low-storage structure-aware Runge-Kutta time stepping //////
+template <typename TCONSLAW>
+void LSSARK<TCONSLAW>::PropagateTent(const Tent & tent, BaseVector & hu,
+				     const BaseVector & hu0, LocalHeap & lh)
+{
+  const int ndof = tent.fedata->nd;
+  FlatMatrixFixWidth<COMP> local_Gu0(ndof,lh);
+  FlatMatrixFixWidth<COMP> local_init(ndof,lh);
+  hu.GetIndirect(tent.fedata->dofs, AsFV(local_Gu0));
+  hu0.GetIndirect(tent.fedata->dofs, AsFV(local_init));
+
+  // state at the beginning of the substep, for output slices (see SliceTent)
+  const bool slices = tcl->HasSlices(tent, hu);
+  FlatMatrixFixWidth<COMP> local_prev;
+  if (slices)
+    {
+      local_prev.AssignMemory(ndof, lh);
+      local_prev = local_Gu0;
+    }
+
+  // registers for the current stage
+  FlatMatrixFixWidth<COMP> u(ndof,lh);
+  FlatMatrixFixWidth<COMP> M1u(ndof,lh);
+  FlatMatrixFixWidth<COMP> fu(ndof,lh);
+
+  // stage values of the stages 1,...,stages-1
+  Array<FlatMatrixFixWidth<COMP>> U(stages);
+  for (auto r : Range(1, stages))
+    U[r].AssignMemory(ndof, lh);
+
+  // does any later stage need M1u of stage s?
+  Array<bool> need_m1(stages);
+  for (auto s : Range(stages))
+    {
+      need_m1[s] = false;
+      for (auto r : Range(s+1, stages))
+	if (dcoeff(r,s) != 0.0)
+	  need_m1[s] = true;
+    }
+
+  shared_ptr<BaseVector> hres = (ECOMP > 0) ? tcl->gfres->GetVectorPtr() : nullptr;
+  FlatMatrixFixWidth<COMP> U0, dUhatdt, local_u, local_help, local_flux;
+  FlatMatrixFixWidth<ECOMP> res;
+  FlatVector<> local_nu;
+  double tau_tent = 0, tau_visc1 = 0;
+  if ((ECOMP > 0 && tcl->entropy_viscosity) || this->implicit_source
+      || tcl->limit_positivity || tcl->limit_bounds)
+    local_u.AssignMemory(ndof, lh);
+  if (ECOMP > 0 && tcl->entropy_viscosity)
+    {
+      U0.AssignMemory(ndof, lh);
+      dUhatdt.AssignMemory(ndof, lh);
+      local_help.AssignMemory(ndof, lh);
+      local_flux.AssignMemory(ndof, lh);
+      res.AssignMemory(ndof, lh);
+      local_nu.AssignMemory(tent.els.Size(), lh);
+
+      tau_tent = tent.ttop - tent.tbot;
+      double h_tent = 0;
+      for (int j : Range(tent.els))
+	h_tent = max2(h_tent, tent.fedata->mesh_size[j]);
+      const int order = max(1,tcl->fes->GetOrder());
+      tau_visc1 = sqr (h_tent / sqr(order));
+    }
+
+  const int nsub = this->TentSubsteps(tent);
+  const double taustar = 1.0/nsub;
+  for (int j = 0; j < nsub; j++)
+    {
+      for (auto r : Range(1, stages))
+	U[r] = local_Gu0;
+      if (ECOMP > 0 && tcl->entropy_viscosity)
+	U0 = local_Gu0;
+
+      // stage 0 uses local_Gu0, which then accumulates the new solution
+      for ( auto s : Range(stages) )
+	{
+	  auto Us = (s == 0) ? local_Gu0 : U[s];
+	  tcl->Cyl2Tent (tent, j*taustar, Us, u, lh);
+	  if (need_m1[s])
+	    tcl->ApplyM1(tent, j*taustar, u, M1u, lh);
+	  tcl->CalcFluxTent(tent, u, local_init, fu,
+			    (j+ccoeff(s))*taustar, 0, lh);
+
+	  for (auto r : Range(s+1, stages))
+	    {
+	      if (acoeff(r,s) != 0.0)
+		U[r] += taustar * acoeff(r,s) * fu;
+	      if (dcoeff(r,s) != 0.0)
+		U[r] += taustar * dcoeff(r,s) * M1u;
+	    }
+	  if (bcoeff(s) != 0.0)
+	    local_Gu0 += taustar * bcoeff(s) * fu;
+	  if (ECOMP > 0 && tcl->entropy_viscosity && s == 0)
+	    dUhatdt = fu;
+	}
+
+      if (ECOMP > 0 && tcl->entropy_viscosity)
+	{
+	  tcl->CalcEntropyResidualTent(tent, U0, dUhatdt, res, local_init, j*taustar, lh);
+	  hres->SetIndirect(tent.fedata->dofs,AsFV(res));
+	  double nu_tent = tcl->CalcViscosityCoefficientTent(tent, U0, res,j*taustar, lh);
+
+	  local_nu = nu_tent;
+	  double steps_visc = (40*tau_tent*nu_tent/tau_visc1)/nsub;
+	  if (steps_visc > 0.2)
+	    {
+	      // store boundary conditions in local_help
+	      tcl->Cyl2Tent (tent, (j+1)*taustar, local_Gu0, local_u, lh);
+	      local_help = local_u;
+	      if (this->implicit_visc)
+		this->CountViscIterations
+		  (tcl->SolveViscosityTent (tent, local_u, local_help, local_nu, taustar, lh));
+	      else
+		{
+		  steps_visc = max(1.0,ceil(steps_visc));
+		  double tau_visc = taustar/steps_visc;
+		  for (int k = 0; k < steps_visc; k++)
+		    {
+		      tcl->CalcViscosityTent (tent, local_u, local_help, local_nu, local_flux, lh);
+		      local_u -= tau_visc * local_flux;
+		    }
+		}
+	      tcl->Tent2Cyl(tent, (j+1)*taustar, local_u, local_Gu0, true, lh);
+	    }
+	}
+
+      if (this->implicit_source)
+	{
+	  tcl->Cyl2Tent (tent, (j+1)*taustar, local_Gu0, local_u, lh);
+	  tcl->ImplicitSourceTent (tent, (j+1)*taustar, taustar, local_u, lh);
+	  tcl->Tent2Cyl (tent, (j+1)*taustar, local_u, local_Gu0, true, lh);
+	}
+
+      if (tcl->limit_positivity || tcl->limit_bounds)
+	tcl->LimitTent (tent, (j+1)*taustar, local_Gu0, local_u, lh);
+      tcl->RecordProbes (tent, hu, (j+1)*taustar, local_Gu0, lh);
+      if (slices)
+	{
+	  tcl->SliceTent (tent, j*taustar, (j+1)*taustar, local_prev, local_Gu0, lh);
+	  local_prev = local_Gu0;
+	}
+    }
+
+  hu.SetIndirect(tent.fedata->dofs, AsFV(local_Gu0));
+};
+
 #endif //TENTSOLVER_IMPL
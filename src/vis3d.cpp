@@ -12,28 +12,50 @@ void Visualization3D::SetInitialHd(
     shared_ptr<MeshAccess> ma = fes->GetMeshAccess();
 
     // Note that tmph1 and vtmp are attributes of the class
-    if  (ma->GetNPeriodicIdentifications() > 0) {
-
-      auto tmph1a = CreateFESpace("h1ho", ma, Flags()
-                            .SetFlag("order", order)
-                            .SetFlag("dim", fes->GetDimension()));
-      tmph1a->Update();
-      tmph1a->FinalizeUpdate();
-      Flags flags = tmph1a->GetFlags();
-      Array<int> emptyarray;
-      shared_ptr<Array<int>> used_idnrs = make_shared<Array<int>>(emptyarray);
-      tmph1 = make_shared<PeriodicFESpace>(tmph1a, flags, used_idnrs);
+    if (!tmph1 || tmph1->GetMeshAccess() != ma || tmph1->GetOrder() != order)
+    {
+      if  (ma->GetNPeriodicIdentifications() > 0) {
+
+        auto tmph1a = CreateFESpace("h1ho", ma, Flags()
+                              .SetFlag("order", order)
+                              .SetFlag("dim", fes->GetDimension()));
+        tmph1a->Update();
+        tmph1a->FinalizeUpdate();
+        Flags flags = tmph1a->GetFlags();
+        Array<int> emptyarray;
+        shared_ptr<Array<int>> used_idnrs = make_shared<Array<int>>(emptyarray);
+        tmph1 = make_shared<PeriodicFESpace>(tmph1a, flags, used_idnrs);
+      }
+      else
+        tmph1 = CreateFESpace("h1ho", ma, Flags()
+                              .SetFlag("order", order)
+                              .SetFlag("dim", fes->GetDimension()));
+
+      tmph1->Update();
+      tmph1->FinalizeUpdate();
+      gftmp = CreateGridFunction(tmph1,"gftmp",Flags().SetFlag("novisual"));
+      gftmp->Update();
+      vtmp = gftmp->GetVectorPtr(0);
+
+      // inverse element mass matrices used by SetForTent
+      shared_ptr<BilinearFormIntegrator> single_bli = tmph1->GetIntegrator(VOL);
+      if (dynamic_pointer_cast<BlockBilinearFormIntegrator> (single_bli))
+        single_bli = dynamic_pointer_cast<BlockBilinearFormIntegrator> (single_bli)->BlockPtr();
+      invmass.SetSize(ma->GetNE(VOL));
+      ParallelFor
+        (Range(invmass), [&] (size_t i)
+         {
+           LocalHeap slh = lh.Split();
+           ElementId ei(VOL, i);
+           const FiniteElement & fel = tmph1->GetFE (ei, slh);
+           const ElementTransformation & eltrans = ma->GetTrafo (ei, slh);
+           FlatMatrix<double> elmat(fel.GetNDof(), slh);
+           single_bli->CalcElementMatrix (fel, eltrans, elmat, slh);
+           CalcInverse (elmat);
+           invmass[i].SetSize(fel.GetNDof(), fel.GetNDof());
+           invmass[i] = elmat;
+         });
     }
-    else
-      tmph1 = CreateFESpace("h1ho", ma, Flags()
-                            .SetFlag("order", order)
-                            .SetFlag("dim", fes->GetDimension()));
-
-    tmph1->Update();
-    tmph1->FinalizeUpdate();
-    auto gftmp = CreateGridFunction(tmph1,"gftmp",Flags().SetFlag("novisual"));
-    gftmp->Update();
-    vtmp = gftmp->GetVectorPtr(0);
 
     ngcomp::SetValues (gfu, *gftmp, VOL, NULL, lh, false, true, 0);
 
@@ -60,6 +82,7 @@ void Visualization3D::SetForTent(
     Tent &tent, shared_ptr<GridFunction> gfu,
     shared_ptr<GridFunction> hdgf, LocalHeap & lh)
 {
+    HeapReset hr(lh);
     auto fes = gfu->GetFESpace();
     auto hdfes = hdgf->GetFESpace();
     int order = hdfes->GetOrder();
@@ -67,18 +90,8 @@ void Visualization3D::SetForTent(
     int NV = ma->GetNV();
     int dim = tmph1->GetDimension();
 
-    Array<int> cnti(tmph1->GetNDof());
-    cnti = 0;
-
     DifferentialOperator * diffop = tmph1->GetEvaluator(VOL).get();
     shared_ptr<BilinearFormIntegrator> bli = tmph1->GetIntegrator(VOL);
-    shared_ptr<BilinearFormIntegrator> single_bli = bli;
-    if (dynamic_pointer_cast<BlockBilinearFormIntegrator> (single_bli))
-      single_bli = dynamic_pointer_cast<BlockBilinearFormIntegrator> (single_bli)->BlockPtr();
-
-    // So we can restore this afterwards
-    bool bli_uses_simd = bli->SimdEvaluate(), sbli_uses_simd = single_bli->SimdEvaluate();
-
     int dimflux = diffop ? diffop->Dim() : bli->DimFlux();
 
     if (gfu -> Dimension() != dimflux)
@@ -87,106 +100,66 @@ void Visualization3D::SetForTent(
 
     auto cachecfs = FindCacheCF (*gfu);
 
-    // zeroing the vector vtmp would create a race condition. Instead
-    // zero out only vector components associated with our tent's elements.
-    IterateElements
-      (*tmph1, VOL, lh,
-       [&] (FESpace::Element ei, LocalHeap & lh)
-       {
-         if (tent.els.Contains(ei.Nr()))
-         {
-            const FiniteElement & fel = tmph1->GetFE (ei, lh);
-            FlatVector<> elzero(fel.GetNDof() * dim, lh);
-            elzero = 0.0;
-            vtmp->SetIndirect (ei.GetDofs(), elzero);
-         }
-       });
-    // TODO: Is there some way to iterate over only tent elements?
-    IterateElements
-      (*tmph1, VOL, lh,
-       [&] (FESpace::Element ei, LocalHeap & lh)
-       {
-         if (tent.els.Contains(ei.Nr()))
-         {
-            const FiniteElement & fel = tmph1->GetFE (ei, lh);
-            int ndof = fel.GetNDof();
-            const ElementTransformation & eltrans = ma->GetTrafo (ei, lh);
-
-            FlatVector<> elflux(ndof * dim, lh);
-            FlatVector<> elfluxi(ndof * dim, lh);
-            FlatVector<> fluxi(dimflux, lh);
-
-            SIMD_IntegrationRule ir(fel.ElementType(), 2*fel.Order());
-            FlatMatrix<SIMD<double>> mfluxi(dimflux, ir.Size(), lh);
-
-            auto & mir = eltrans(ir, lh);
-
-            ProxyUserData ud;
-            const_cast<ElementTransformation&>(eltrans).userdata = &ud;
-            PrecomputeCacheCF (cachecfs, mir, lh);
-
-            gfu->Evaluate (mir, mfluxi);
-
-            for (size_t j : Range(ir))
-              mfluxi.Col(j) *= mir[j].GetWeight();
-
-            elflux = 0.0;
-            diffop -> AddTrans (fel, mir, mfluxi, elflux);
-
-            if (dim > 1)
-              {
-                FlatMatrix<double> elmat(fel.GetNDof(), lh);
-                single_bli->CalcElementMatrix (fel, eltrans, elmat, lh);
-                FlatCholeskyFactors<double> invelmat(elmat, lh);
-
-                for (int j = 0; j < dim; j++)
-                  invelmat.Mult (elflux.Slice (j,dim), elfluxi.Slice (j,dim));
-              }
-            else
-              {
-                FlatMatrix<double> elmat(fel.GetNDof(), lh);
-                bli->CalcElementMatrix (fel, eltrans, elmat, lh);
-
-                // Transform solution inverse instead
-                CalcLDL<double,ColMajor> (Trans(elmat));
-                elfluxi = elflux;
-                SolveLDL<double,ColMajor> (Trans(elmat), elfluxi);
-              }
-
-            tmph1->TransformVec (ei, elfluxi, TRANSFORM_SOL_INVERSE);
-
-            vtmp->GetIndirect (ei.GetDofs(), elflux);
-            elfluxi += elflux;
-            vtmp->SetIndirect (ei.GetDofs(), elfluxi);
-
-            for (auto d : ei.GetDofs())
-              if (IsRegularDof(d)) cnti[d]++;
-         }
-    });
-
-    // Restore simd evaluate
-    bli->SetSimdEvaluate(bli_uses_simd);
-    single_bli->SetSimdEvaluate(sbli_uses_simd);
-
-    VectorMem<10,double> fluxi(dim);
-    ArrayMem<int,1> dnums(1);
-
-    ParallelForRange
-      (cnti.Size(), [&] (IntRange r)
-       {
-         VectorMem<10,double> fluxi(dim);
-         ArrayMem<int,1> dnums(1);
-         for (auto i : r)
-           if (cnti[i])
-             {
-               dnums[0] = i;
-               vtmp->GetIndirect (dnums, fluxi);
-               fluxi /= cnti[i];
-               vtmp->SetIndirect (dnums, fluxi);
-             }
-       });
-
-    // Transfer dof values from vtmp to vhd
+    // dofs of the tent elements, the averaged interpolant is assembled
+    // into the tent-local vector tentvals
+    Array<DofId> tentdofs, eldofs;
+    for (int elnr : tent.els)
+      {
+        tmph1->GetDofNrs (ElementId(VOL, elnr), eldofs);
+        for (auto d : eldofs)
+          if (IsRegularDof(d) && !tentdofs.Contains(d))
+            tentdofs.Append(d);
+      }
+    FlatMatrix<> tentvals(tentdofs.Size(), dim, lh);
+    FlatArray<int> cnti(tentdofs.Size(), lh);
+    tentvals = 0.0;
+    cnti = 0;
+
+    for (int elnr : tent.els)
+      {
+        HeapReset hr(lh);
+        ElementId ei(VOL, elnr);
+        tmph1->GetDofNrs (ei, eldofs);
+        const FiniteElement & fel = tmph1->GetFE (ei, lh);
+        int ndof = fel.GetNDof();
+        const ElementTransformation & eltrans = ma->GetTrafo (ei, lh);
+
+        FlatVector<> elflux(ndof * dim, lh);
+        FlatVector<> elfluxi(ndof * dim, lh);
+
+        SIMD_IntegrationRule ir(fel.ElementType(), 2*fel.Order());
+        FlatMatrix<SIMD<double>> mfluxi(dimflux, ir.Size(), lh);
+
+        auto & mir = eltrans(ir, lh);
+
+        ProxyUserData ud;
+        const_cast<ElementTransformation&>(eltrans).userdata = &ud;
+        PrecomputeCacheCF (cachecfs, mir, lh);
+
+        gfu->Evaluate (mir, mfluxi);
+
+        for (size_t j : Range(ir))
+          mfluxi.Col(j) *= mir[j].GetWeight();
+
+        elflux = 0.0;
+        diffop -> AddTrans (fel, mir, mfluxi, elflux);
+
+        for (int j = 0; j < dim; j++)
+          elfluxi.Slice (j,dim) = invmass[elnr] * elflux.Slice (j,dim);
+
+        tmph1->TransformVec (ei, elfluxi, TRANSFORM_SOL_INVERSE);
+
+        for (size_t k : Range(eldofs))
+          if (IsRegularDof(eldofs[k]))
+            {
+              auto pos = tentdofs.Pos(eldofs[k]);
+              for (int j = 0; j < dim; j++)
+                tentvals(pos, j) += elfluxi(k*dim+j);
+              cnti[pos]++;
+            }
+      }
+
+    // Transfer dof values from the tent to vhd
     Array<int> vtmp_nrs;
     Array<int> vhd_nrs;
     vtmp_nrs.Append(tent.vertex);
@@ -201,23 +174,17 @@ void Visualization3D::SetForTent(
       vhd_nrs.Append((*(idx3d[tent.level+1]))[i][0]);
 
     shared_ptr<BaseVector> vhd = hdgf->GetVectorPtr(0);
-    int entrysize = vtmp->EntrySize();
 
-    if(entrysize == 1)
-    {
-      for (auto i : IntRange(vtmp_nrs.Size()))
+    for (auto i : IntRange(vtmp_nrs.Size()))
       {
-        auto fv = vtmp->FVDouble();
+        auto pos = tentdofs.Pos(vtmp_nrs[i]);
+        if (pos == tentdofs.ILLEGAL_POSITION || !cnti[pos])
+          continue;
         auto vi = vhd_nrs[i];
-        vhd->Range(vi,vi+1) = fv[vtmp_nrs[i]];
-      }
-    }
-    else
-    {
-      for (auto i : IntRange(vtmp_nrs.Size()))
-      {
-        auto sv = vtmp->SV<double>();
-        vhd->SV<double>()(vhd_nrs[i]) = sv(vtmp_nrs[i]);
+        if (dim == 1)
+          vhd->FVDouble()(vi) = tentvals(pos, 0) / cnti[pos];
+        else
+          for (int j = 0; j < dim; j++)
+            vhd->SV<double>()(vi)(j) = tentvals(pos, j) / cnti[pos];
       }
-    }
 }
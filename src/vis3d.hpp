@@ -14,6 +14,8 @@ public:
 
   // Set the initial data (layer 0) for the timestep/slab
   // into the GridFunction vector for the 3D H1 space.
+  // The temporary H1 space and the element matrices are set up
+  // at the first call only.
   void SetInitialHd(shared_ptr<GridFunction> gfu,
                     shared_ptr<GridFunction> hdgf, LocalHeap & lh);
 
@@ -25,11 +27,13 @@ public:
 private:
   // idx3d[layer][2D vertex nr] --> vertex nr in 3D mesh
   Array<shared_ptr<Table<int>>> idx3d;
-  // temporary H1 space used by SetForTent only for tmph1->TransformVec()
+  // temporary H1 space, interpolation of the solution
   shared_ptr<FESpace> tmph1;
-  // GridFunction vector associated with temp H1 space
-  // When used by SetForTent, only vector components associated with tent
-  // element dofs are affected; so no race condition is present.
+  shared_ptr<GridFunction> gftmp;
+  // GridFunction vector associated with temp H1 space (initial data only,
+  // SetForTent works on tent-local vectors)
   shared_ptr<BaseVector> vtmp;
+  // inverse (scalar) H1 element mass matrices of tmph1
+  Array<Matrix<>> invmass;
 };
 #endif
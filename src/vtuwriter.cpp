@@ -0,0 +1,244 @@
+#include "vtuwriter.hpp"
+#include <fstream>
+#include <filesystem>
+#ifdef NGSTENTS_USE_ZLIB
+#include <zlib.h>
+#endif
+
+
+// binary block of the appended data section, with the UInt64 header
+// of VTK (byte count, or the block table for compressed data)
+static void Encode (const void * data, size_t nbytes, bool compress,
+                    std::vector<char> & out)
+{
+  auto append = [&out] (const void * p, size_t n)
+    {
+      auto c = static_cast<const char*>(p);
+      out.insert(out.end(), c, c+n);
+    };
+
+  if (!compress)
+    {
+      uint64_t n = nbytes;
+      append(&n, sizeof(n));
+      append(data, nbytes);
+      return;
+    }
+#ifdef NGSTENTS_USE_ZLIB
+  // a single block: #blocks, block size, size of a partial last block,
+  // compressed size
+  uLongf clen = compressBound(nbytes);
+  std::vector<char> buf(clen);
+  if (compress2(reinterpret_cast<Bytef*>(buf.data()), &clen,
+                static_cast<const Bytef*>(data), nbytes,
+                Z_DEFAULT_COMPRESSION) != Z_OK)
+    throw Exception("VTU output: zlib compression failed");
+  uint64_t header[4] = { 1, nbytes, 0, clen };
+  append(header, sizeof(header));
+  append(buf.data(), clen);
+#else
+  throw Exception("ngstents was built without zlib, use compress=False");
+#endif
+}
+
+static string ByteOrder ()
+{
+  const uint16_t one = 1;
+  return *reinterpret_cast<const uint8_t*>(&one) ? "LittleEndian" : "BigEndian";
+}
+
+static string VTKFileTag (const string & type, bool compress)
+{
+  return "<VTKFile type=\"" + type + "\" version=\"1.0\" byte_order=\""
+    + ByteOrder() + "\" header_type=\"UInt64\""
+    + (compress ? " compressor=\"vtkZLibDataCompressor\"" : "") + ">\n";
+}
+
+
+void VTUPiece :: Write (const string & filename, bool compress) const
+{
+  // encode all arrays first, the header contains their offsets
+  std::vector<char> appended;
+  auto array = [&] (const string & attribs, const void * data, size_t nbytes)
+    {
+      string s = "<DataArray " + attribs + " format=\"appended\" offset=\""
+        + ToString(appended.size()) + "\"/>\n";
+      Encode(data, nbytes, compress, appended);
+      return s;
+    };
+  auto dataarrays = [&] (const Array<DataArray> & data)
+    {
+      string s;
+      for (auto & d : data)
+        s += array("type=\"Float32\" Name=\"" + d.name + "\" NumberOfComponents=\""
+                   + ToString(d.ncomp) + "\"",
+                   d.values.Data(), d.values.Size()*sizeof(float));
+      return s;
+    };
+
+  string header;
+  header += "<?xml version=\"1.0\"?>\n";
+  header += VTKFileTag("UnstructuredGrid", compress);
+  header += "<UnstructuredGrid>\n";
+  header += "<Piece NumberOfPoints=\"" + ToString(points.Size())
+    + "\" NumberOfCells=\"" + ToString(types.Size()) + "\">\n";
+  header += "<PointData>\n" + dataarrays(pointdata) + "</PointData>\n";
+  header += "<CellData>\n" + dataarrays(celldata) + "</CellData>\n";
+  header += "<Points>\n"
+    + array("type=\"Float64\" NumberOfComponents=\"3\"",
+            points.Data(), points.Size()*sizeof(Vec<3>))
+    + "</Points>\n";
+  header += "<Cells>\n";
+  header += array("type=\"Int64\" Name=\"connectivity\"",
+                  connectivity.Data(), connectivity.Size()*sizeof(int64_t));
+  header += array("type=\"Int64\" Name=\"offsets\"",
+                  offsets.Data(), offsets.Size()*sizeof(int64_t));
+  header += array("type=\"UInt8\" Name=\"types\"",
+                  types.Data(), types.Size()*sizeof(uint8_t));
+  header += "</Cells>\n";
+  header += "</Piece>\n";
+  header += "</UnstructuredGrid>\n";
+
+  std::ofstream out(filename, std::ios::binary);
+  if (!out)
+    throw Exception("cannot open " + filename);
+  out << header;
+  out << "<AppendedData encoding=\"raw\">\n_";
+  out.write(appended.data(), appended.size());
+  out << "\n</AppendedData>\n";
+  out << "</VTKFile>\n";
+}
+
+
+uint8_t VTKCellType (ELEMENT_TYPE et)
+{
+  switch (et)
+    {
+    case ET_POINT: return 1;
+    case ET_SEGM: return 3;
+    case ET_TRIG: return 5;
+    case ET_QUAD: return 9;
+    case ET_TET: return 10;
+    case ET_HEX: return 12;
+    case ET_PRISM: return 13;
+    case ET_PYRAMID: return 14;
+    default:
+      throw Exception("no VTK cell type for element type "
+                      + ToString(ElementTopology::GetElementName(et)));
+    }
+}
+
+
+void WriteVTU (const string & filename, int nparts, bool compress,
+               const function<void(int, VTUPiece&)> & fill)
+{
+  namespace fs = std::filesystem;
+  if (nparts <= 0)
+    nparts = TaskManager::GetNumThreads();
+
+  if (nparts == 1)
+    {
+      VTUPiece piece;
+      fill(0, piece);
+      piece.Write(filename + ".vtu", compress);
+      return;
+    }
+
+  // data arrays of the pieces, for the .pvtu file
+  Array<std::pair<string,int>> pointarrays, cellarrays;
+  ParallelFor
+    (Range(nparts), [&] (size_t part)
+     {
+       VTUPiece piece;
+       fill(part, piece);
+       piece.Write(filename + "_" + ToString(part) + ".vtu", compress);
+       if (part == 0)
+         {
+           for (auto & d : piece.pointdata)
+             pointarrays.Append(std::make_pair(d.name, d.ncomp));
+           for (auto & d : piece.celldata)
+             cellarrays.Append(std::make_pair(d.name, d.ncomp));
+         }
+     });
+
+  auto pdataarrays = [] (const Array<std::pair<string,int>> & arrays)
+    {
+      string s;
+      for (auto & [name, ncomp] : arrays)
+        s += "<PDataArray type=\"Float32\" Name=\"" + name
+          + "\" NumberOfComponents=\"" + ToString(ncomp) + "\"/>\n";
+      return s;
+    };
+
+  std::ofstream out(filename + ".pvtu");
+  if (!out)
+    throw Exception("cannot open " + filename + ".pvtu");
+  out << "<?xml version=\"1.0\"?>\n";
+  out << VTKFileTag("PUnstructuredGrid", compress);
+  out << "<PUnstructuredGrid GhostLevel=\"0\">\n";
+  out << "<PPointData>\n" << pdataarrays(pointarrays) << "</PPointData>\n";
+  out << "<PCellData>\n" << pdataarrays(cellarrays) << "</PCellData>\n";
+  out << "<PPoints>\n<PDataArray type=\"Float64\" NumberOfComponents=\"3\"/>\n</PPoints>\n";
+  // pieces are referenced relative to the .pvtu file
+  string base = fs::path(filename).filename().string();
+  for (int part : Range(nparts))
+    out << "<Piece Source=\"" << base << "_" << part << ".vtu\"/>\n";
+  out << "</PUnstructuredGrid>\n";
+  out << "</VTKFile>\n";
+}
+
+
+void WriteSolutionVTU (shared_ptr<MeshAccess> ma,
+                       shared_ptr<CoefficientFunction> cf, const string & name,
+                       shared_ptr<GridFunction> gftime, FlatArray<int> vmap,
+                       const string & filename, int nparts, bool compress)
+{
+  const int dim = ma->GetDimension();
+  const int ncomp = cf->Dimension();
+  const size_t ne = ma->GetNE(VOL);
+  if (nparts <= 0)
+    nparts = TaskManager::GetNumThreads();
+
+  WriteVTU
+    (filename, nparts, compress, [&] (int part, VTUPiece & piece)
+     {
+       LocalHeap lh(1000000, "vtu output");
+       auto & values = piece.PointData(name, ncomp).values;
+       auto times = gftime ? &piece.PointData("time", 1).values : nullptr;
+       auto & elnr = piece.CellData("element", 1).values;
+       FlatVector<> val(ncomp, lh);
+       Array<size_t> pnums;
+
+       for (size_t i : Range(ne).Split(part, nparts))
+         {
+           HeapReset hr(lh);
+           ElementId ei(VOL, i);
+           auto & trafo = ma->GetTrafo(ei, lh);
+           ELEMENT_TYPE et = trafo.GetElementType();
+           const POINT3D * refverts = ElementTopology::GetVertices(et);
+           auto vnums = ma->GetElVertices(ei);
+
+           pnums.SetSize0();
+           for (size_t k : Range(vnums))
+             {
+               IntegrationPoint ip(refverts[k][0], refverts[k][1], refverts[k][2]);
+               auto & mip = trafo(ip, lh);
+               Vec<3> p = 0.0;
+               for (int d : Range(dim))
+                 p(d) = mip.GetPoint()(d);
+               pnums.Append(piece.AddPoint(p));
+
+               cf->Evaluate(mip, val);
+               for (auto v : val)
+                 values.Append(v);
+               if (times)
+                 {
+                   int v = vmap.Size() ? vmap[vnums[k]] : vnums[k];
+                   times->Append(gftime->GetVector().FVDouble()(v));
+                 }
+             }
+           piece.AddCell(VTKCellType(et), pnums);
+           elnr.Append(i);
+         }
+     });
+}
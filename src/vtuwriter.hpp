@@ -0,0 +1,88 @@
+#ifndef VTUWRITER_HPP
+#define VTUWRITER_HPP
+
+#include <solve.hpp>
+using namespace ngsolve;
+
+
+////////////////////////////////////////////////////////////////////////////
+///
+/// Piece of an unstructured grid written as VTK XML file (.vtu).
+///
+/// All data arrays are appended in raw binary after the XML header,
+/// optionally zlib compressed (if ngstents is built with zlib).
+/// Points are written in double precision (the time coordinate of
+/// space-time cells needs it), point and cell data in single precision.
+///
+class VTUPiece
+{
+public:
+  struct DataArray
+  {
+    string name;
+    int ncomp;
+    Array<float> values;
+  };
+
+  Array<Vec<3>> points;
+  Array<int64_t> connectivity;
+  Array<int64_t> offsets;     ///< end of each cell in connectivity
+  Array<uint8_t> types;       ///< VTK cell types
+  Array<DataArray> pointdata;
+  Array<DataArray> celldata;
+
+  size_t AddPoint (Vec<3> p)
+  {
+    points.Append(p);
+    return points.Size()-1;
+  }
+
+  void AddCell (uint8_t type, FlatArray<size_t> pnums)
+  {
+    for (auto p : pnums)
+      connectivity.Append(p);
+    offsets.Append(connectivity.Size());
+    types.Append(type);
+  }
+
+  /// data array with the given name, created on first use
+  DataArray & PointData (const string & name, int ncomp)
+  { return Find(pointdata, name, ncomp); }
+  DataArray & CellData (const string & name, int ncomp)
+  { return Find(celldata, name, ncomp); }
+
+  void Write (const string & filename, bool compress) const;
+
+private:
+  static DataArray & Find (Array<DataArray> & data, const string & name, int ncomp)
+  {
+    for (auto & d : data)
+      if (d.name == name)
+        return d;
+    data.Append(DataArray{name, ncomp, Array<float>()});
+    return data.Last();
+  }
+};
+
+/// VTK cell type of a (linear) spatial element
+uint8_t VTKCellType (ELEMENT_TYPE et);
+
+/// Build nparts pieces by fill(part, piece) and write them in parallel.
+/// For one part the grid goes to filename.vtu, otherwise the pieces go
+/// to filename_<part>.vtu and are collected by filename.pvtu.  All
+/// pieces must define the same data arrays.  nparts = 0 uses one part
+/// per thread of the task manager.
+void WriteVTU (const string & filename, int nparts, bool compress,
+               const function<void(int, VTUPiece&)> & fill);
+
+/// Write a coefficient function evaluated at the vertices of all
+/// elements (discontinuous, points are not shared), with the values of
+/// gftime at the vertices as point data "time" (if given).  gftime is
+/// read at vmap[v] of each vertex v (periodic meshes: only the master
+/// vertices of the tents are up to date), no map if vmap is empty.
+void WriteSolutionVTU (shared_ptr<MeshAccess> ma,
+                       shared_ptr<CoefficientFunction> cf, const string & name,
+                       shared_ptr<GridFunction> gftime, FlatArray<int> vmap,
+                       const string & filename, int nparts, bool compress);
+
+#endif // VTUWRITER_HPP
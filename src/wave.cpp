@@ -2,6 +2,7 @@
 using namespace ngsolve;
 
 #include "tconservationlaw_tp_impl.hpp"
+#include "cfcache.hpp"
 
 template <int D>
 class Wave : public T_ConservationLaw<Wave<D>, D, D+1, 0>
@@ -11,6 +12,8 @@ class Wave : public T_ConservationLaw<Wave<D>, D, D+1, 0>
   bool use_mu_eps = false;
   shared_ptr<CoefficientFunction> cf_mu = nullptr;
   shared_ptr<CoefficientFunction> cf_eps = nullptr;
+  shared_ptr<CoefficientCache> cache_mu = nullptr;
+  shared_ptr<CoefficientCache> cache_eps = nullptr;
   typedef T_ConservationLaw<Wave<D>, D, D+1, 0> BASE;
   
 public:
@@ -25,11 +28,38 @@ public:
   using BASE::u_transparent;
   
   void SetMaterialParameters(shared_ptr<CoefficientFunction> mu,
-			     shared_ptr<CoefficientFunction> eps)
+			     shared_ptr<CoefficientFunction> eps,
+                             bool cache)
   {
     use_mu_eps = true;
     cf_mu = mu;
     cf_eps = eps;
+    cache_mu = cache_eps = nullptr;
+    if (cache)
+      {
+        HeapReset hr(*this->pylh);
+        cache_mu = make_shared<CoefficientCache>(cf_mu, this->ma, this->order,
+                                                 *this->pylh);
+        cache_eps = make_shared<CoefficientCache>(cf_eps, this->ma, this->order,
+                                                  *this->pylh);
+      }
+  }
+
+  // values of mu and eps in the points of mir
+  void EvaluateMuEps (const SIMD_BaseMappedIntegrationRule & mir,
+                      FlatMatrix<SIMD<double>> mu,
+                      FlatMatrix<SIMD<double>> eps) const
+  {
+    if (cache_mu)
+      {
+        cache_mu->Evaluate(mir, mu);
+        cache_eps->Evaluate(mir, eps);
+      }
+    else
+      {
+        cf_mu->Evaluate(mir, mu);
+        cf_eps->Evaluate(mir, eps);
+      }
   }
 
   // solve for û: Û = ĝ(x̂, t̂, û) - ∇̂ φ(x̂, t̂) ⋅ f̂(x̂, t̂, û)
@@ -38,21 +68,19 @@ public:
   void InverseMap(const SIMD_BaseMappedIntegrationRule & mir,
 		  FlatMatrix<T> grad, FlatMatrix<T> u) const
   {
-    Matrix<T> mu(1, mir.Size());
-    Matrix<T> eps(1, mir.Size());
+    STACK_ARRAY(SIMD<double>, mem, 2*mir.Size());
+    FlatMatrix<SIMD<double>> mu(1, mir.Size(), mem);
+    FlatMatrix<SIMD<double>> eps(1, mir.Size(), mem+mir.Size());
     if(use_mu_eps)
-      {
-        cf_mu->Evaluate(mir,mu);
-        cf_eps->Evaluate(mir,eps);
-      }
+      EvaluateMuEps(mir, mu, eps);
     for (int i : Range(grad.Width()))
       {
         T mueps = T(1.0);
         if(use_mu_eps)
           {
-            mueps = mu(i)*eps(i);
+            mueps = T(mu(i)*eps(i));
             for(int j : Range(D))
-              u(j,i) *= 1.0/mu(i);
+              u(j,i) *= T(1.0/mu(i));
           }
 	T prod = T(0.0);
 	T norm = T(0.0);
@@ -66,7 +94,7 @@ public:
 	auto p = fac * (u(D,i) + prod);
         for(int j : Range(D))
           u(j,i) += p * grad(j,i);
-	u(D,i) = (use_mu_eps) ? mu(i)*p : p;
+	u(D,i) = (use_mu_eps) ? T(mu(i))*p : p;
       }
   }
 
@@ -142,13 +170,11 @@ public:
                      FlatMatrix<SIMD<double>> u, FlatMatrix<SIMD<double>> normals,
                      FlatMatrix<SIMD<double>> u_transp) const
   {
-    Matrix<SIMD<double>> mu(1, mir.Size());
-    Matrix<SIMD<double>> eps(1, mir.Size());
+    STACK_ARRAY(SIMD<double>, mem, 2*mir.Size());
+    FlatMatrix<SIMD<double>> mu(1, mir.Size(), mem);
+    FlatMatrix<SIMD<double>> eps(1, mir.Size(), mem+mir.Size());
     if(use_mu_eps)
-      {
-        cf_mu->Evaluate(mir,mu);
-        cf_eps->Evaluate(mir,eps);
-      }
+      EvaluateMuEps(mir, mu, eps);
     u_transp.Rows(0,D) = u.Rows(0,D);
     for (int i : Range(u.Width()))
       {
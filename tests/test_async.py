@@ -0,0 +1,102 @@
+import pytest
+from ngsolve import (Mesh, L2, H1, GridFunction, CoefficientFunction,
+                     TaskManager, SetNumThreads, Integrate, exp, sin, x, y)
+from netgen.geom2d import unit_square
+from ngstents import TentSlab
+from ngstents.conslaw import Advection
+
+
+def setup(mesh):
+    ts = TentSlab(mesh, method="edge")
+    ts.SetMaxWavespeed(1)
+    return ts
+
+
+def advection(mesh, ts):
+    gfu = GridFunction(L2(mesh, order=2))
+    cl = Advection(gfu, ts, inflow=mesh.Boundaries(".*"))
+    cl.SetVectorField(CoefficientFunction((1, 0.5)))
+    cl.SetTentSolver("SARK", stages=3, substeps=2)
+    cl.SetInitial(exp(-50*((x-0.4)**2+(y-0.4)**2)))
+    return gfu, cl
+
+
+def test_async_matches_blocking():
+    '''
+    PitchTentsAsync and PropagateAsync run in a background thread
+    and give the results of the blocking calls
+    '''
+    SetNumThreads(2)
+    mesh = Mesh(unit_square.GenerateMesh(maxh=0.15))
+    ts = setup(mesh)
+    assert ts.PitchTentsAsync(0.1).result()
+    ts_ref = setup(mesh)
+    with TaskManager():
+        assert ts_ref.PitchTents(0.1)
+    assert ts.GetNTents() == ts_ref.GetNTents()
+
+    gfu, cl = advection(mesh, ts)
+    gfu_ref, cl_ref = advection(mesh, ts)
+    handle = cl.PropagateAsync()
+    # the blocking call waits for the background computation
+    cl_ref.Propagate()
+    assert handle.result()
+    assert handle.done()
+    diff = gfu.vec.FV().NumPy() - gfu_ref.vec.FV().NumPy()
+    assert abs(diff).max() < 1e-12
+
+
+def test_async_in_taskmanager_raises():
+    '''
+    the background thread can not share the task manager of the caller
+    '''
+    mesh = Mesh(unit_square.GenerateMesh(maxh=0.3))
+    ts = setup(mesh)
+    with TaskManager():
+        with pytest.raises(Exception):
+            ts.PitchTentsAsync(0.1)
+
+
+def test_async_overlap():
+    '''
+    NGSolve work of the main thread while a job runs gives the results
+    it gives without the job, and does not disturb the job
+    '''
+    mesh = Mesh(unit_square.GenerateMesh(maxh=0.1))
+    ts = setup(mesh)
+    ts.PitchTents(0.1)
+    cf = sin(3*x)*exp(y)
+    gf_ref = GridFunction(H1(mesh, order=3))
+    gf_ref.Set(cf)
+    integral_ref = Integrate(cf*gf_ref, mesh)
+
+    gfu, cl = advection(mesh, ts)
+    gfu_ref, cl_ref = advection(mesh, ts)
+    cl_ref.Propagate()
+    handle = cl.PropagateAsync()
+    gf = GridFunction(H1(mesh, order=3))
+    for _ in range(5):
+        gf.Set(cf)
+        assert abs(Integrate(cf*gf, mesh) - integral_ref) <= 1e-12 * abs(integral_ref)
+    assert handle.result()
+    assert abs(gf.vec.FV().NumPy() - gf_ref.vec.FV().NumPy()).max() <= 1e-12
+    diff = gfu.vec.FV().NumPy() - gfu_ref.vec.FV().NumPy()
+    assert abs(diff).max() < 1e-12
+
+
+def test_async_twice():
+    '''
+    a second async call while a job runs waits for it
+    '''
+    mesh = Mesh(unit_square.GenerateMesh(maxh=0.15))
+    ts = setup(mesh)
+    ts.PitchTents(0.1)
+    gfu, cl = advection(mesh, ts)
+    gfu_ref, cl_ref = advection(mesh, ts)
+    first = cl.PropagateAsync()
+    second = cl.PropagateAsync()
+    assert first.result() and second.result()
+    for _ in range(2):
+        cl_ref.Propagate()
+    diff = gfu.vec.FV().NumPy() - gfu_ref.vec.FV().NumPy()
+    assert abs(diff).max() < 1e-12
@@ -0,0 +1,56 @@
+from ngsolve import (Mesh, L2, GridFunction, CoefficientFunction, TaskManager,
+                     exp, x, y)
+from netgen.geom2d import unit_square
+from ngstents import TentSlab
+from ngstents.conslaw import Advection, Wave
+
+mesh = Mesh(unit_square.GenerateMesh(maxh=0.15))
+gauss = exp(-50*((x-0.4)**2+(y-0.4)**2))
+
+
+def slab():
+    ts = TentSlab(mesh, method="edge")
+    ts.SetMaxWavespeed(2)
+    ts.PitchTents(0.05)
+    return ts
+
+
+def advection(cache):
+    gfu = GridFunction(L2(mesh, order=3))
+    cl = Advection(gfu, slab(), inflow=mesh.Boundaries(".*"))
+    cl.SetVectorField(CoefficientFunction((1+y, 0.5-x)), cache=cache)
+    cl.SetTentSolver("SARK", stages=3, substeps=2)
+    cl.SetInitial(gauss)
+    with TaskManager():
+        for _ in range(2):
+            cl.Propagate()
+    return gfu.vec.FV().NumPy().copy()
+
+
+def wave(cache):
+    gfu = GridFunction(L2(mesh, order=3, dim=3))
+    cl = Wave(gfu, slab(), reflect=mesh.Boundaries(".*"))
+    cl.SetMaterialParameters(mu=1+x, eps=2-y, cache=cache)
+    cl.SetTentSolver("SAT", stages=4, substeps=4)
+    cl.SetInitial(CoefficientFunction((0, 0, gauss)))
+    with TaskManager():
+        for _ in range(2):
+            cl.Propagate()
+    return gfu.vec.FV().NumPy().copy()
+
+
+def test_cache_advection():
+    '''
+    the cached vector field gives the same solution as the evaluated one
+    '''
+    u0, u1 = advection(False), advection(True)
+    assert abs(u1 - u0).max() <= 1e-12 * abs(u0).max()
+
+
+def test_cache_wave():
+    '''
+    the cached material parameters give the same solution as the
+    evaluated ones
+    '''
+    u0, u1 = wave(False), wave(True)
+    assert abs(u1 - u0).max() <= 1e-12 * abs(u0).max()
@@ -0,0 +1,60 @@
+from ngsolve import (Mesh, L2, GridFunction, CoefficientFunction, exp, x, y)
+from netgen.geom2d import unit_square
+from ngstents import TentSlab
+from ngstents.conslaw import Advection
+
+mesh = Mesh(unit_square.GenerateMesh(maxh=0.2))
+dt = 0.05
+
+
+def setup(method="edge"):
+    ts = TentSlab(mesh, method=method)
+    ts.SetMaxWavespeed(1)
+    ts.PitchTents(dt)
+    gfu = GridFunction(L2(mesh, order=2))
+    cl = Advection(gfu, ts, inflow=mesh.Boundaries(".*"))
+    cl.SetVectorField(CoefficientFunction((1, 0.5)))
+    cl.SetTentSolver("SARK", stages=3, substeps=2)
+    cl.SetInitial(exp(-50*((x-0.4)**2+(y-0.4)**2)))
+    return gfu, cl, ts
+
+
+def restart(tmp_path, slab, method):
+    '''
+    2 slabs, checkpoint, restart in a new conservation law (slab pitched
+    with method), 2 more slabs; compared with 4 slabs without a restart
+    '''
+    gfu_ref, cl_ref, _ = setup()
+    for _ in range(4):
+        cl_ref.Propagate()
+
+    gfu, cl, _ = setup()
+    for _ in range(2):
+        cl.Propagate()
+    filename = str(tmp_path / "checkpoint")
+    cl.SaveCheckpoint(filename, slab=slab)
+    cl.WaitCheckpoint()
+
+    gfu2, cl2, ts2 = setup(method)
+    gfu2.vec[:] = 0
+    cl2.LoadCheckpoint(filename)
+    assert abs(cl2.time - 2*dt) < 1e-12
+    assert abs(gfu2.vec.FV().NumPy() - gfu.vec.FV().NumPy()).max() == 0
+    for _ in range(2):
+        cl2.Propagate()
+    assert abs(cl2.time - 4*dt) < 1e-12
+    return abs(gfu2.vec.FV().NumPy() - gfu_ref.vec.FV().NumPy()).max()
+
+
+def test_checkpoint(tmp_path):
+    '''
+    without the tents: the new slab is pitched the same way
+    '''
+    assert restart(tmp_path, slab=False, method="edge") == 0
+
+
+def test_checkpoint_slab(tmp_path):
+    '''
+    with the tents: they replace the tents of a slab pitched differently
+    '''
+    assert restart(tmp_path, slab=True, method="vol") < 1e-14
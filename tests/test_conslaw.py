@@ -41,6 +41,20 @@ def test_advection2d():
     import advection2d
     assert advection2d.l2error <= 3e-3
 
+def test_advection2d_ensemble():
+    '''
+    ensemble member with the same initial data as the solution
+    gives the same result
+    '''
+    import advection2d_ensemble
+    assert advection2d_ensemble.maxdiff <= 1e-12
+    # the view keeps its memory when the ensemble is reallocated
+    U = advection2d_ensemble.U
+    before = U.copy()
+    advection2d_ensemble.cl.SetEnsemble([advection2d_ensemble.Pulse(0, 0)])
+    assert advection2d_ensemble.cl.ensemble.shape[0] == 1
+    assert (U == before).all()
+
 def test_symbolic_wave():
     ''' 
     reference values generated with NGSolve-6.2.2102-17-g02efd4be3
@@ -54,9 +68,127 @@ def test_symbolic_wave():
     import symbolic_wave
     assert symbolic_wave.l2error <= 4e-4
 
+def test_symbolic_advection_source():
+    '''
+    stiff relaxation source k=1e4 with the IMEX tent solver:
+    the solution relaxes to the equilibrium without substeps ~ k
+    '''
+    import symbolic_advection_source
+    assert symbolic_advection_source.l2dev <= 1e-4
+
+def test_symbolic_advection_decay():
+    '''
+    advected pulse decaying like exp(-k t), k=5, with the IMEX tent
+    solver, compared with the exact solution at t=0.2
+    '''
+    import symbolic_advection_decay
+    assert symbolic_advection_decay.l2error <= 5e-2
+
+def test_euler_simd():
+    '''
+    SIMD and scalar versions of erf, the kinetic flux and the reflected
+    state of Euler agree on random states, also near vacuum (needs a
+    build with cmake -DNGSTENTS_TESTING=ON)
+    '''
+    import pytest
+    from ngsolve import Mesh, L2, GridFunction
+    from netgen.geom2d import unit_square
+    from ngstents import TentSlab
+    from ngstents.conslaw import Euler
+    from ngstents.conslaw import _pyconslaw
+    if not hasattr(_pyconslaw, "_EulerCompareSIMD"):
+        pytest.skip("ngstents built without NGSTENTS_TESTING")
+    _EulerCompareSIMD = _pyconslaw._EulerCompareSIMD
+    mesh = Mesh(unit_square.GenerateMesh(maxh=0.5))
+    ts = TentSlab(mesh)
+    ts.SetMaxWavespeed(1)
+    ts.PitchTents(0.1)
+    cl = Euler(GridFunction(L2(mesh, order=1, dim=4)), ts,
+               reflect=mesh.Boundaries(".*"))
+    err_erf, err_flux, err_refl = _EulerCompareSIMD(cl, n=10000, seed=1)
+    assert err_erf <= 1e-12
+    assert err_flux <= 1e-8
+    assert err_refl <= 1e-12
+
+def test_adaptive_substeps():
+    '''
+    adaptive substeps with a variable wavespeed: tents in the slow part
+    get fewer substeps, but no tent fewer than its wavespeed times slope
+    relative to the maximum over the slab requires, and the solution
+    agrees with the one of the non-adaptive solver
+    '''
+    from math import ceil
+    from ngsolve import Mesh, L2, GridFunction, NodeId, VERTEX, x, exp, y
+    from netgen.geom2d import unit_square
+    from ngstents import TentSlab
+    from ngstents.conslaw import Burgers
+    mesh = Mesh(unit_square.GenerateMesh(maxh=0.1))
+    ts = TentSlab(mesh, method="edge")
+    ts.SetMaxWavespeed(1+3*x)
+    ts.PitchTents(dt=0.05, local_ct=True, global_ct=0.5)
+    substeps = 8
+
+    def propagate(adaptive):
+        gfu = GridFunction(L2(mesh, order=2))
+        cl = Burgers(gfu, ts, outflow=mesh.Boundaries(".*"))
+        cl.SetTentSolver("SAT", stages=3, substeps=substeps, adaptive=adaptive)
+        cl.SetInitial(0.1*exp(-50*((x-0.5)**2+(y-0.5)**2)))
+        cl.Propagate()
+        return gfu, cl
+
+    gfu, cl = propagate(adaptive=True)
+    gfu_ref, cl_ref = propagate(adaptive=False)
+    assert all(n == substeps for n in cl_ref.tent_substeps)
+    assert min(cl.tent_substeps) < substeps
+    assert sum(cl.tent_substeps) < 0.9 * sum(cl_ref.tent_substeps)
+
+    def speed(v):
+        # maximal wavespeed at the centers of the elements around v
+        cs = []
+        for el in mesh[NodeId(VERTEX, v)].elements:
+            pts = [mesh[w].point for w in mesh[el].vertices]
+            cs.append(1+3*sum(p[0] for p in pts)/len(pts))
+        return max(cs)
+
+    data = ts.GetTentData()
+    bounds = [speed(v)*s for v, s in zip(data["vertex"], data["maxslope"])]
+    maxbound = max(bounds)
+    for n, b in zip(cl.tent_substeps, bounds):
+        assert n >= min(substeps, ceil(substeps*b/maxbound - 1e-8))
+
+    u, u_ref = gfu.vec.FV().NumPy(), gfu_ref.vec.FV().NumPy()
+    assert abs(u - u_ref).max() <= 1e-3 * abs(u_ref).max()
+
+def test_time_periodic():
+    '''
+    the time after each slab on a periodic mesh (the front is not
+    updated at the periodic servant vertex), PropagateUntil stops at tend
+    '''
+    from ngsolve import Mesh, L2, GridFunction, x, exp
+    from ngstents import TentSlab
+    from ngstents.conslaw import Burgers
+    from ngstents.utils import Make1DPeriodicMesh
+    mesh = Mesh(Make1DPeriodicMesh(50))
+    dt = 0.05
+    ts = TentSlab(mesh, method="edge")
+    ts.SetMaxWavespeed(1)
+    ts.PitchTents(dt)
+    cl = Burgers(GridFunction(L2(mesh, order=2)), ts)
+    cl.SetTentSolver("SAT", stages=3, substeps=2)
+    cl.SetInitial(0.5*exp(-50*(x-0.5)**2))
+    times = []
+    nslabs = cl.PropagateUntil(0.2, callback=lambda n, t: times.append(t))
+    assert nslabs == 4
+    assert max(abs(t-(k+1)*dt) for k, t in enumerate(times)) < 1e-12
+    assert abs(cl.time - 0.2) < 1e-12
+
 if __name__ == "__main__":
     functions = [test_wave2d, test_wave2d_timdepbc,
-                 test_advection2d, test_symbolic_wave]
+                 test_advection2d, test_advection2d_ensemble,
+                 test_symbolic_wave, test_symbolic_advection_source,
+                 test_symbolic_advection_decay,
+                 test_euler_simd, test_adaptive_substeps,
+                 test_time_periodic]
     passed = []
     print("Test wave equation:")
     for func in functions:
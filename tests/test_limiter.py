@@ -0,0 +1,75 @@
+from ngsolve import (Mesh, L2, GridFunction, CoefficientFunction, TaskManager,
+                     Integrate, IntegrationRule, IfPos, SEGM, x)
+from ngstents import TentSlab
+from ngstents.utils import Make1DMesh
+from ngstents.conslaw import Euler
+
+mesh = Mesh(Make1DMesh([[0, 1]], [200], bcname=["left", "right"]))
+order = 2
+
+
+def euler(rho, u, p, limiter, viscosity):
+    ts = TentSlab(mesh, method="edge")
+    ts.SetMaxWavespeed(4)
+    ts.PitchTents(dt=0.02, local_ct=True, global_ct=1/2)
+    gfu = GridFunction(L2(mesh, order=order, dim=3))
+    cl = Euler(gfu, ts, reflect=mesh.Boundaries("left|right"))
+    cl.SetTentSolver("SARK", stages=3, substeps=4)
+    if limiter:
+        cl.SetLimiter(positivity=True, viscosity=viscosity)
+    # E = d/4 T rho + 1/2 rho u^2 with d = 5 and T = 2 p/rho
+    cl.SetInitial(CoefficientFunction((rho, rho*u, 2.5*p + 0.5*rho*u*u)))
+    return gfu, cl
+
+
+def double_rarefaction(limiter=True):
+    # two rarefactions running apart leave a near-vacuum in the middle
+    return euler(1, IfPos(x-0.5, 2, -2), 0.4, limiter, viscosity=False)
+
+
+def points():
+    # the points of the element rules of the tents
+    ir = IntegrationRule(SEGM, 2*order)
+    for el in mesh.Elements():
+        x0, x1 = [mesh[v].point[0] for v in el.vertices]
+        for ip in ir.points:
+            yield x0 + ip[0]*(x1-x0)
+
+
+def test_positivity():
+    '''
+    the positivity limiter without viscosity keeps density and pressure
+    positive at the integration points
+    '''
+    gfu, cl = double_rarefaction()
+    with TaskManager():
+        for _ in range(3):
+            cl.Propagate()
+    for xp in points():
+        rho, m, E = gfu(mesh(xp))
+        assert rho > 0
+        assert 0.4*(E - 0.5*m*m/rho) > 0
+
+
+def test_conservation():
+    '''
+    the limiter does not change the total mass between reflecting walls
+    '''
+    gfu, cl = double_rarefaction()
+    mass = Integrate(gfu[0], mesh, order=2*order)
+    with TaskManager():
+        for _ in range(3):
+            cl.Propagate()
+    assert abs(Integrate(gfu[0], mesh, order=2*order) - mass) <= 1e-12 * mass
+
+
+def test_cost():
+    '''
+    on Sod's shock tube the limiter is cheaper than a viscosity step
+    '''
+    gfu, cl = euler(IfPos(x-0.5, 0.125, 1), 0, IfPos(x-0.5, 0.1, 1),
+                    limiter=True, viscosity=True)
+    with TaskManager():
+        cl.Propagate()
+        timing = cl.Timing(reps=5)
+    assert 0 < timing["LimitTent"] < timing["Viscosity"]
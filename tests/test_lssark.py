@@ -0,0 +1,57 @@
+from ngsolve import (Mesh, L2, GridFunction, CoefficientFunction, TaskManager,
+                     exp, x, y)
+from netgen.geom2d import unit_square
+from ngstents import TentSlab
+from ngstents.conslaw import Advection, Burgers
+
+mesh = Mesh(unit_square.GenerateMesh(maxh=0.15))
+gauss = exp(-50*((x-0.4)**2+(y-0.4)**2))
+
+
+def slab():
+    ts = TentSlab(mesh, method="edge")
+    ts.SetMaxWavespeed(2)
+    ts.PitchTents(0.05)
+    return ts
+
+
+def advection(method, stages):
+    gfu = GridFunction(L2(mesh, order=3))
+    cl = Advection(gfu, slab(), inflow=mesh.Boundaries(".*"))
+    cl.SetVectorField(CoefficientFunction((1, 0.5)))
+    cl.SetTentSolver(method, stages=stages, substeps=3)
+    cl.SetInitial(gauss)
+    with TaskManager():
+        for _ in range(2):
+            cl.Propagate()
+    return gfu.vec.FV().NumPy().copy()
+
+
+def burgers(method, stages):
+    # ECOMP = 1: with entropy residual and viscosity
+    gfu = GridFunction(L2(mesh, order=3))
+    cl = Burgers(gfu, slab(), outflow=mesh.Boundaries(".*"))
+    cl.SetTentSolver(method, stages=stages, substeps=3)
+    cl.SetInitial(1.5*gauss)
+    with TaskManager():
+        for _ in range(2):
+            cl.Propagate()
+    return gfu.vec.FV().NumPy().copy()
+
+
+def test_lssark_advection():
+    '''
+    the low-storage implementation gives the results of SARK
+    '''
+    for stages in [2, 3, 5]:
+        u0, u1 = advection("SARK", stages), advection("LSSARK", stages)
+        assert abs(u1 - u0).max() <= 1e-12 * abs(u0).max()
+
+
+def test_lssark_viscosity():
+    '''
+    the same with entropy viscosity (ECOMP > 0)
+    '''
+    for stages in [3, 5]:
+        u0, u1 = burgers("SARK", stages), burgers("LSSARK", stages)
+        assert abs(u1 - u0).max() <= 1e-12 * abs(u0).max()
@@ -0,0 +1,66 @@
+import os
+from ngsolve import (Mesh, L2, GridFunction, CoefficientFunction, TaskManager,
+                     IfPos, InnerProduct, exp, x, y)
+from ngsolve import specialcf as scf
+from netgen.geom2d import SplineGeometry
+from ngstents import TentSlab
+from ngstents.conslaw import ConservationLaw
+
+
+def periodic_mesh(maxh):
+    periodic = SplineGeometry()
+    pnts = [(0, 0), (1, 0), (1, 1), (0, 1)]
+    pnums = [periodic.AppendPoint(*p) for p in pnts]
+    lbot = periodic.Append(["line", pnums[0], pnums[1]], bc="bottom")
+    lright = periodic.Append(["line", pnums[1], pnums[2]], bc="right")
+    periodic.Append(["line", pnums[0], pnums[3]], leftdomain=0,
+                    rightdomain=1, bc="left", copy=lright)
+    periodic.Append(["line", pnums[3], pnums[2]], leftdomain=0,
+                    rightdomain=1, bc="top", copy=lbot)
+    return Mesh(periodic.GenerateMesh(maxh=maxh))
+
+
+mesh = periodic_mesh(0.15)
+b = CoefficientFunction((1, 0.3))
+n = scf.normal(mesh.dim)
+
+
+def advection(native):
+    ts = TentSlab(mesh, method="edge")
+    ts.SetMaxWavespeed(1.5)
+    ts.PitchTents(0.1)
+    gfu = GridFunction(L2(mesh, order=3))
+    cl = ConservationLaw(
+        gfu, ts,
+        flux=lambda u: CoefficientFunction(b*u, dims=(1, mesh.dim)),
+        numflux=lambda um, up: IfPos(b*n, (b*n)*um, (b*n)*up),
+        inversemap=lambda u: u/(1-InnerProduct(b, ts.gradphi)),
+        native=native)
+    cl.SetTentSolver("SAT", stages=4, substeps=4)
+    cl.SetInitial(exp(-50*((x-0.5)**2+(y-0.5)**2)))
+    with TaskManager():
+        for _ in range(2):
+            cl.Propagate()
+    return gfu.vec.FV().NumPy().copy()
+
+
+def cached_files(cachedir):
+    return {f: os.stat(os.path.join(cachedir, f)).st_mtime_ns
+            for f in os.listdir(cachedir)}
+
+
+def test_native(tmp_path, monkeypatch):
+    '''
+    native kernels give the interpreted results; a second construction
+    loads the libraries from the on-disk cache without compiling again
+    '''
+    monkeypatch.setenv("NGSTENTS_CACHE_DIR", str(tmp_path))
+    u_interp = advection(native=False)
+    u_native = advection(native=True)
+    assert abs(u_native - u_interp).max() <= 1e-12 * abs(u_interp).max()
+
+    files = cached_files(tmp_path)
+    assert len([f for f in files if f.endswith(".so")]) == 3
+    u_native2 = advection(native=True)
+    assert cached_files(tmp_path) == files
+    assert abs(u_native2 - u_native).max() == 0
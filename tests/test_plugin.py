@@ -0,0 +1,71 @@
+from ngsolve import (Mesh, L2, GridFunction, CoefficientFunction, TaskManager,
+                     IfPos, InnerProduct, exp, x, y)
+from ngsolve import specialcf as scf
+from netgen.geom2d import SplineGeometry
+from ngstents import TentSlab
+from ngstents.conslaw import ConservationLaw
+
+
+def periodic_mesh(maxh):
+    periodic = SplineGeometry()
+    pnts = [(0, 0), (1, 0), (1, 1), (0, 1)]
+    pnums = [periodic.AppendPoint(*p) for p in pnts]
+    lbot = periodic.Append(["line", pnums[0], pnums[1]], bc="bottom")
+    lright = periodic.Append(["line", pnums[1], pnums[2]], bc="right")
+    periodic.Append(["line", pnums[0], pnums[3]], leftdomain=0,
+                    rightdomain=1, bc="left", copy=lright)
+    periodic.Append(["line", pnums[3], pnums[2]], leftdomain=0,
+                    rightdomain=1, bc="top", copy=lbot)
+    return Mesh(periodic.GenerateMesh(maxh=maxh))
+
+
+mesh = periodic_mesh(0.2)
+n = scf.normal(mesh.dim)
+ncomp = 8
+# vector field and initial data of each component
+fields = [CoefficientFunction((1, 0.1*k)) for k in range(ncomp)]
+initial = [exp(-50*((x-0.3-0.05*k)**2+(y-0.5)**2)) for k in range(ncomp)]
+
+
+def propagate(bs, u0s):
+    ts = TentSlab(mesh, method="edge")
+    ts.SetMaxWavespeed(1.8)
+    ts.PitchTents(0.1)
+    m = len(bs)
+    gfu = GridFunction(L2(mesh, order=2, dim=m))
+
+    def comps(u):
+        return [u] if m == 1 else [u[k] for k in range(m)]
+
+    def flux(u):
+        return CoefficientFunction(tuple(b*uk for b, uk in zip(bs, comps(u))),
+                                   dims=(m, mesh.dim))
+
+    def numflux(um, up):
+        return CoefficientFunction(tuple(
+            IfPos(b*n, (b*n)*umk, (b*n)*upk)
+            for b, umk, upk in zip(bs, comps(um), comps(up))))
+
+    def inversemap(u):
+        return CoefficientFunction(tuple(
+            uk/(1-InnerProduct(b, ts.gradphi)) for b, uk in zip(bs, comps(u))))
+
+    cl = ConservationLaw(gfu, ts, flux=flux, numflux=numflux,
+                         inversemap=inversemap)
+    cl.SetTentSolver("SAT", stages=3, substeps=2)
+    cl.SetInitial(CoefficientFunction(tuple(u0s)))
+    with TaskManager():
+        for _ in range(2):
+            cl.Propagate()
+    return gfu.vec.FV().NumPy().reshape(-1, m)
+
+
+def test_plugin():
+    '''
+    8 decoupled advection equations (instantiated in a plugin compiled
+    on first use) give the solutions of the single equations
+    '''
+    u = propagate(fields, initial)
+    for k in range(ncomp):
+        uk = propagate(fields[k:k+1], initial[k:k+1])[:, 0]
+        assert abs(u[:, k] - uk).max() <= 1e-12 * abs(uk).max()
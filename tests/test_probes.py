@@ -0,0 +1,39 @@
+from ngsolve import (Mesh, L2, GridFunction, CoefficientFunction, TaskManager,
+                     exp, x, y)
+from netgen.geom2d import unit_square
+from ngstents import TentSlab
+from ngstents.conslaw import Advection
+import numpy as np
+
+
+def exact(px, py, t):
+    return np.exp(-50*((px-t-0.4)**2+(py-0.5*t-0.4)**2))
+
+
+def test_probe():
+    '''
+    advection of a Gaussian: the samples of a probe are in time order,
+    within the slabs, and close to the exact solution
+    '''
+    mesh = Mesh(unit_square.GenerateMesh(maxh=0.1))
+    dt = 0.05
+    ts = TentSlab(mesh, method="edge")
+    ts.SetMaxWavespeed(1.2)
+    ts.PitchTents(dt)
+    gfu = GridFunction(L2(mesh, order=4))
+    cl = Advection(gfu, ts, inflow=mesh.Boundaries(".*"))
+    cl.SetVectorField(CoefficientFunction((1, 0.5)))
+    cl.SetTentSolver("SARK", stages=4, substeps=4)
+    cl.SetInitial(exp(-50*((x-0.4)**2+(y-0.4)**2)))
+
+    point = [0.45, 0.43]
+    probe = cl.AddProbe(point)
+    with TaskManager():
+        for _ in range(2):
+            cl.Propagate()
+    times, values = cl.GetProbe(probe)
+    assert len(times) > 4
+    assert values.shape == (len(times), 1)
+    assert (np.diff(times) >= 0).all()
+    assert times.min() > 0 and times.max() <= 2*dt + 1e-12
+    assert abs(values[:, 0] - exact(point[0], point[1], times)).max() < 1e-2
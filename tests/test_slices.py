@@ -0,0 +1,68 @@
+from ngsolve import (Mesh, L2, GridFunction, CoefficientFunction, TaskManager,
+                     Integrate, exp, x, y)
+from netgen.geom2d import unit_square
+from ngstents import TentSlab
+from ngstents.conslaw import Advection
+from math import sqrt
+
+mesh = Mesh(unit_square.GenerateMesh(maxh=0.1))
+b = (1, 0.5)
+
+
+def gauss(t):
+    return exp(-50*((x-b[0]*t-0.4)**2+(y-b[1]*t-0.4)**2))
+
+
+def propagate(dt, output_times=None):
+    ts = TentSlab(mesh, method="edge")
+    ts.SetMaxWavespeed(1.2)
+    ts.PitchTents(dt)
+    gfu = GridFunction(L2(mesh, order=4))
+    cl = Advection(gfu, ts, inflow=mesh.Boundaries(".*"))
+    cl.SetVectorField(CoefficientFunction(b))
+    cl.SetTentSolver("SARK", stages=4, substeps=4)
+    cl.SetInitial(gauss(0))
+    with TaskManager():
+        slices = cl.Propagate(output_times=output_times)
+    return gfu, slices
+
+
+def l2norm(cf):
+    return sqrt(Integrate(cf*cf, mesh))
+
+
+def test_slice():
+    '''
+    advection of a Gaussian: the solution on a slice within the slab is
+    close to the solution of a slab ending at this time and to the exact
+    solution
+    '''
+    t = 0.03
+    _, slices = propagate(0.05, output_times=[t])
+    assert len(slices) == 1
+    gfref, _ = propagate(t)
+    norm = l2norm(gauss(t))
+    assert l2norm(slices[0] - gfref) < 1e-2 * norm
+    assert l2norm(slices[0] - gauss(t)) < 1e-2 * norm
+
+
+def test_slice_after_async():
+    '''
+    output times of a blocking Propagate are set up after a running
+    PropagateAsync is done, they do not end up in its slab
+    '''
+    ts = TentSlab(mesh, method="edge")
+    ts.SetMaxWavespeed(1.2)
+    ts.PitchTents(0.05)
+    gfu = GridFunction(L2(mesh, order=4))
+    cl = Advection(gfu, ts, inflow=mesh.Boundaries(".*"))
+    cl.SetVectorField(CoefficientFunction(b))
+    cl.SetTentSolver("SARK", stages=4, substeps=4)
+    cl.SetInitial(gauss(0))
+    t = 0.08
+    handle = cl.PropagateAsync()
+    slices = cl.Propagate(output_times=[t])
+    assert handle.result()
+    assert len(slices) == 1
+    norm = l2norm(gauss(t))
+    assert l2norm(slices[0] - gauss(t)) < 1e-2 * norm
@@ -0,0 +1,48 @@
+from ngsolve import (Mesh, L2, GridFunction, CoefficientFunction, TaskManager,
+                     exp, x, y)
+from netgen.geom2d import unit_square
+from ngstents import TentSlab
+from ngstents.conslaw import Advection, SnapshotTimes, ReadSnapshot
+
+
+def test_snapshots(tmp_path):
+    '''
+    snapshots every second slab: times and vectors read back equal the
+    solution after these slabs
+    '''
+    mesh = Mesh(unit_square.GenerateMesh(maxh=0.2))
+    dt = 0.05
+    ts = TentSlab(mesh, method="edge")
+    ts.SetMaxWavespeed(1)
+    ts.PitchTents(dt)
+    gfu = GridFunction(L2(mesh, order=2))
+    cl = Advection(gfu, ts, inflow=mesh.Boundaries(".*"))
+    cl.SetVectorField(CoefficientFunction((1, 0.5)))
+    cl.SetTentSolver("SARK", stages=3, substeps=2)
+    cl.SetInitial(exp(-50*((x-0.4)**2+(y-0.4)**2)))
+
+    filename = str(tmp_path / "snapshots")
+    cl.SetSnapshots(filename, every=2)
+    solutions = []
+    with TaskManager():
+        for _ in range(5):
+            cl.Propagate()
+            solutions.append(gfu.vec.FV().NumPy().copy())
+    cl.FlushSnapshots()
+
+    times = SnapshotTimes(filename)
+    assert len(times) == 2
+    assert abs(times[0] - 2*dt) < 1e-12
+    assert abs(times[1] - 4*dt) < 1e-12
+
+    gfr = GridFunction(gfu.space)
+    for k, slab in enumerate([1, 3]):
+        t = ReadSnapshot(filename, gfr, index=k)
+        assert t == times[k]
+        assert abs(gfr.vec.FV().NumPy() - solutions[slab]).max() == 0
+    # closest to a given time
+    t = ReadSnapshot(filename, gfr, time=3.9*dt)
+    assert t == times[1]
+    assert abs(gfr.vec.FV().NumPy() - solutions[3]).max() == 0
+
+    cl.SetSnapshots(None)
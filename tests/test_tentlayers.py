@@ -17,3 +17,39 @@ def test_tent_nlayers():
     layers = set([t.level for t in tents])
     assert len(layers) == tentslab.GetNLayers(), "Incorrect number of layers"
 
+
+
+def test_tent_data():
+    mesh = Mesh(unit_square.GenerateMesh(maxh=.3))
+    tentslab = TentSlab(mesh, "edge")
+    tentslab.SetMaxWavespeed(1)
+    tentslab.PitchTents(0.2)
+    data = tentslab.GetTentData()
+    assert len(data["vertex"]) == tentslab.GetNTents()
+    for i in range(tentslab.GetNTents()):
+        tent = tentslab.GetTent(i)
+        assert data["vertex"][i] == tent.vertex
+        assert data["ttop"][i] == tent.ttop
+        for name in ["nbv", "els", "internal_facets"]:
+            offsets = data[name + "_offsets"]
+            rng = slice(offsets[i], offsets[i+1])
+            assert list(data[name][rng]) == list(getattr(tent, name))
+        rng = slice(data["nbv_offsets"][i], data["nbv_offsets"][i+1])
+        assert list(data["nbtime"][rng]) == list(tent.nbtime)
+
+
+def test_spacetime_mesh():
+    from ngsolve import Integrate, VOL, BND
+    mesh = Mesh(unit_square.GenerateMesh(maxh=.3))
+    dt = 0.2
+    tentslab = TentSlab(mesh, "edge")
+    tentslab.SetMaxWavespeed(1)
+    tentslab.PitchTents(dt)
+    stmesh = tentslab.ToSpaceTimeMesh(order=2)
+    assert len(stmesh) == tentslab.GetNLayers() + 1
+    assert len(stmesh[0]) == mesh.nv + mesh.nedge
+    assert abs(Integrate(1, stmesh.mesh, VOL) - dt) < 1e-12
+    # base and final front have the area of the spatial domain
+    for bnd in ["base", "final"]:
+        area = Integrate(1, stmesh.mesh.Boundaries(bnd), BND)
+        assert abs(area - 1) < 1e-12 if bnd == "base" else area >= 1
@@ -0,0 +1,35 @@
+from ngsolve import (Mesh, L2, GridFunction, CoefficientFunction, TaskManager,
+                     exp, x, y)
+from netgen.geom2d import unit_square
+from ngstents import TentSlab
+from ngstents.conslaw import Advection
+
+mesh = Mesh(unit_square.GenerateMesh(maxh=0.2))
+
+
+def setup():
+    ts = TentSlab(mesh, method="edge")
+    ts.SetMaxWavespeed(1)
+    ts.PitchTents(0.05)
+    gfu = GridFunction(L2(mesh, order=2))
+    cl = Advection(gfu, ts, inflow=mesh.Boundaries(".*"))
+    cl.SetVectorField(CoefficientFunction((1, 0.5)))
+    cl.SetTentSolver("SARK", stages=3, substeps=2)
+    cl.SetInitial(exp(-50*((x-0.4)**2+(y-0.4)**2)))
+    return gfu, cl
+
+
+def test_timing():
+    '''
+    Timing leaves the solution and the time front unchanged: a slab
+    propagated after it equals one propagated without it
+    '''
+    gfu_ref, cl_ref = setup()
+    gfu, cl = setup()
+    with TaskManager():
+        cl_ref.Propagate()
+        timing = cl.Timing(reps=2)
+        cl.Propagate()
+    assert all(t >= 0 for t in timing.values())
+    assert abs(cl.time - cl_ref.time) == 0
+    assert abs(gfu.vec.FV().NumPy() - gfu_ref.vec.FV().NumPy()).max() == 0
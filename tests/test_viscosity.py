@@ -0,0 +1,45 @@
+from ngsolve import (Mesh, L2, GridFunction, CoefficientFunction, TaskManager,
+                     Integrate, IfPos, x)
+from ngstents import TentSlab
+from ngstents.utils import Make1DMesh
+from ngstents.conslaw import Euler
+
+mesh = Mesh(Make1DMesh([[0, 1]], [200], bcname=["left", "right"]))
+
+
+def sod(implicit_visc):
+    '''
+    Sod's shock tube with entropy viscosity, density after 3 slabs
+    '''
+    ts = TentSlab(mesh, method="edge")
+    ts.SetMaxWavespeed(3)
+    ts.PitchTents(dt=0.05, local_ct=True, global_ct=1/2)
+    gfu = GridFunction(L2(mesh, order=2, dim=3))
+    cl = Euler(gfu, ts, reflect=mesh.Boundaries("left|right"))
+    cl.SetTentSolver("SARK", stages=3, substeps=4, implicit_visc=implicit_visc)
+    rho = IfPos(x-0.5, 0.125, 1)
+    p = IfPos(x-0.5, 0.1, 1)
+    # E = d/4 T rho with d = 5 and T = 2 p/rho
+    cl.SetInitial(CoefficientFunction((rho, 0, 2.5*p)))
+    iterations = []
+    with TaskManager():
+        for _ in range(3):
+            cl.Propagate()
+            iterations.append(cl.visc_iterations)
+    return gfu[0], iterations
+
+
+def test_implicit_viscosity():
+    '''
+    one implicit viscosity solve per substep gives the density of the
+    explicit viscosity steps up to the splitting error, with few CG
+    iterations per solve
+    '''
+    rho_expl, it_expl = sod(implicit_visc=False)
+    rho_impl, it_impl = sod(implicit_visc=True)
+    assert max(it_expl) == 0
+    assert max(it_impl) > 0
+    assert max(it_impl) <= 30
+    diff = rho_impl - rho_expl
+    l1diff = Integrate(IfPos(diff, diff, -diff), mesh)
+    assert l1diff <= 2e-2 * Integrate(rho_expl, mesh)
@@ -0,0 +1,100 @@
+import re
+import struct
+from ngsolve import Mesh, CoefficientFunction, L2, GridFunction, exp, x, y
+from netgen.geom2d import SplineGeometry
+from ngstents import TentSlab
+from ngstents.conslaw import Advection
+
+
+def periodic_mesh(maxh):
+    geo = SplineGeometry()
+    pnts = [(0, 0), (1, 0), (1, 1), (0, 1)]
+    pnums = [geo.AppendPoint(*p) for p in pnts]
+    lbot = geo.Append(["line", pnums[0], pnums[1]], bc="bottom")
+    lright = geo.Append(["line", pnums[1], pnums[2]], bc="right")
+    geo.Append(["line", pnums[0], pnums[3]], leftdomain=0,
+               rightdomain=1, bc="left", copy=lright)
+    geo.Append(["line", pnums[3], pnums[2]], leftdomain=0,
+               rightdomain=1, bc="top", copy=lbot)
+    return Mesh(geo.GenerateMesh(maxh=maxh))
+
+
+def read_vtu(filename):
+    '''
+    header (XML) and the uncompressed appended arrays of a VTU file
+    written by ngstents, as {name: bytes}
+    '''
+    with open(filename, "rb") as f:
+        data = f.read()
+    marker = b'<AppendedData encoding="raw">\n_'
+    pos = data.index(marker)
+    header = data[:pos].decode()
+    appended = data[pos+len(marker):]
+    arrays = {}
+    for attribs in re.findall(r"<DataArray ([^>]*)/>", header):
+        name = re.search(r'Name="([^"]*)"', attribs)
+        name = name.group(1) if name else "points"
+        offset = int(re.search(r'offset="(\d+)"', attribs).group(1))
+        nbytes, = struct.unpack_from("<Q", appended, offset)
+        arrays[name] = appended[offset+8:offset+8+nbytes]
+    return header, arrays
+
+
+def test_vtu_periodic(tmp_path):
+    '''
+    solution output on a periodic mesh after one slab: sizes of the
+    piece, and the time of all vertices (also the periodic ones) is the
+    top of the slab
+    '''
+    mesh = periodic_mesh(0.3)
+    dt = 0.1
+    ts = TentSlab(mesh, method="edge")
+    ts.SetMaxWavespeed(1.5)
+    ts.PitchTents(dt)
+    gfu = GridFunction(L2(mesh, order=2))
+    cl = Advection(gfu, ts)
+    cl.SetVectorField(CoefficientFunction((1, 0.2)))
+    cl.SetTentSolver("SARK", stages=3, substeps=2)
+    cl.SetInitial(exp(-50*((x-0.5)**2+(y-0.5)**2)))
+    cl.Propagate()
+
+    filename = str(tmp_path / "solution")
+    cl.WriteVTU(filename, compress=False, nparts=1)
+    header, arrays = read_vtu(filename + ".vtu")
+
+    ne = mesh.ne
+    npoints = int(re.search(r'NumberOfPoints="(\d+)"', header).group(1))
+    ncells = int(re.search(r'NumberOfCells="(\d+)"', header).group(1))
+    assert ncells == ne
+    assert npoints == 3*ne
+    assert len(arrays["u"]) == 4*npoints
+    assert len(arrays["points"]) == 3*8*npoints
+    assert len(arrays["connectivity"]) == 8*3*ne
+    assert len(arrays["types"]) == ne
+
+    times = struct.unpack("<{}f".format(npoints), arrays["time"])
+    assert all(abs(t-dt) < 1e-6 for t in times)
+
+
+def test_vtu_active_tents(tmp_path):
+    '''
+    export of the tents active at a time: the full patches of exactly
+    the tents whose pole contains the time
+    '''
+    mesh = periodic_mesh(0.3)
+    ts = TentSlab(mesh, method="edge")
+    ts.SetMaxWavespeed(1.5)
+    ts.PitchTents(0.1)
+    t = 0.05
+    active = [i for i in range(ts.GetNTents())
+              if ts.GetTent(i).tbot <= t < ts.GetTent(i).ttop]
+    assert len(active) > 0
+
+    filename = str(tmp_path / "tents")
+    ts.DrawPitchedTentsVTU(filename, nparts=1, active_times=[t])
+    header, arrays = read_vtu(filename + "_active0.vtu")
+
+    ncells = int(re.search(r'NumberOfCells="(\d+)"', header).group(1))
+    assert ncells == sum(len(ts.GetTent(i).els) for i in active)
+    tentnrs = struct.unpack("<{}f".format(ncells), arrays["tentnumber"])
+    assert set(int(i) for i in tentnrs) == set(active)